@@ -27,6 +27,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 
 #include <bh_config_parser.hpp>
+#include <bh_util.hpp>
 
 #ifdef _WIN32
 
@@ -273,6 +274,20 @@ vector<boost::filesystem::path> ConfigParser::getListOfPaths(const std::string &
     return ret;
 }
 
+uint64_t ConfigParser::hashOfSection(const vector<string> &ignore) const {
+    stringstream ss;
+    ss << _default_section << "\n";
+    const auto section = _config.get_child_optional(_default_section);
+    if (section) {
+        for (const auto &option: *section) {
+            if (std::find(ignore.begin(), ignore.end(), option.first) == ignore.end()) {
+                ss << option.first << "=" << lookup(_default_section, option.first) << "\n";
+            }
+        }
+    }
+    return util::hash(ss.str());
+}
+
 string ConfigParser::getChildLibraryPath() const {
     // Do we have a child?
     if (static_cast<int>(_stack_list.size()) <= stack_level+1) {
@@ -1,67 +1,577 @@
-/*
-This file is part of Bohrium and copyright (c) 2012 the Bohrium
-team <http://www.bh107.org>.
-
-Bohrium is free software: you can redistribute it and/or modify
-it under the terms of the GNU Lesser General Public License as
-published by the Free Software Foundation, either version 3
-of the License, or (at your option) any later version.
-
-Bohrium is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the
-GNU Lesser General Public License along with Bohrium.
-
-If not, see <http://www.gnu.org/licenses/>.
-*/
-
-#ifdef _WIN32
-#include <malloc.h>
-#else
-#include <sys/mman.h>
-#endif
-#include <cstddef>
-
-#include <bh_memory.h>
-#include <bh_win.h>
-
-/* Allocate an alligned contigous block of memory,
- * does not apply any initialization
- *
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-void* bh_memory_malloc(int64_t size)
-{
-#ifdef _WIN32
-    return _aligned_malloc(size, 16);
-#else
-    //Allocate page-size aligned memory.
-    //The MAP_PRIVATE and MAP_ANONYMOUS flags is not 100% portable. See:
-    //<http://stackoverflow.com/questions/4779188/how-to-use-mmap-to-allocate-a-memory-in-heap>
-    void* data = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-    if(data == MAP_FAILED)
-        return NULL;
-    else
-        return data;
-#endif
-}
-
-/* Frees a previously allocated data block
- *
- * @data  The pointer returned from a call to bh_memory_malloc
- * @size  The size of the allocated block
- * @return A pointer to data, and NULL on error
- */
-int64_t bh_memory_free(void* data, int64_t size)
-{
-#ifdef _WIN32
-	_aligned_free(data);
-	return 0;
-#else
-	return munmap(data, size);
-#endif
-}
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <bh_memory.h>
+#include <bh_win.h>
+
+#ifndef _WIN32
+namespace {
+
+/* Pool of freed data blocks, which makes it possible to reuse the memory of temporary arrays
+ * without a mmap()/munmap() pair, page faults, and TLB shootdowns for every array.
+ * The size class of a block is its size rounded up to whole pages, which is the size of the mapping
+ * thus a block handed to another owner through mremap() or munmap() is never larger than expected.
+ */
+class MemoryPool {
+public:
+    std::mutex mutex;
+    // The free blocks of each size class
+    std::unordered_map<uint64_t, std::vector<void*> > free_blocks;
+    // The size class of the blocks currently allocated by the pool
+    std::unordered_map<void*, uint64_t> allocated;
+    // The maximum number of bytes to retain in `free_blocks`
+    uint64_t max_retained = 256 * 1024 * 1024;
+    // Blocks of this size or larger are advised to use huge pages (0 disables)
+    // NB: the thresholds are atomic since bh_memory_malloc() reads them without holding `mutex`
+    std::atomic<uint64_t> hugepage_threshold{0};
+    const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    bh_memory_pool_stat stat = {0, 0, 0, 0, 0, 0};
+    // Blocks of this size or larger are backed by a file in `spill_dir` (0 or an empty dir disables)
+    std::atomic<uint64_t> spill_threshold{0};
+    std::string spill_dir;
+    // The file and size class of the file-backed blocks, which are never retained by the pool
+    struct FileBlock {
+        int fd;
+        uint64_t nbytes;
+    };
+    std::unordered_map<void*, FileBlock> file_backed;
+
+    uint64_t sizeClass(int64_t size) const {
+        return (static_cast<uint64_t>(size) + page_size - 1) / page_size * page_size;
+    }
+
+    // Unmap free blocks until at most `max_bytes` are retained. NB: the caller must hold `mutex`
+    void trim(uint64_t max_bytes) {
+        for (auto it = free_blocks.begin(); it != free_blocks.end() and stat.retained > max_bytes;) {
+            while (not it->second.empty() and stat.retained > max_bytes) {
+                munmap(it->second.back(), it->first);
+                it->second.pop_back();
+                stat.retained -= it->first;
+            }
+            if (it->second.empty()) {
+                it = free_blocks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+// NB: the pool is never destructed since arrays might be freed by other static destructors at exit
+MemoryPool &pool() {
+    static MemoryPool *ret = new MemoryPool();
+    return *ret;
+}
+
+// The memory policies of the mbind() system call (see <numaif.h>)
+constexpr int BH_MPOL_PREFERRED = 1;
+constexpr int BH_MPOL_INTERLEAVE = 3;
+
+// Parse a Linux CPU or node list such as "0-3,8-11"
+std::vector<int> parse_id_list(const std::string &list) {
+    std::vector<int> ret;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() or range[0] == '\n') {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int i = first; i <= last; ++i) {
+            ret.push_back(i);
+        }
+    }
+    return ret;
+}
+
+/* The NUMA topology of the machine and the placement policy of bh_memory_malloc().
+ * NB: the topology is read once thus it must be constructed before any thread pins itself
+ */
+class Numa {
+public:
+    bh_numa_policy policy = BH_NUMA_NONE;
+    uint64_t num_threads = 1;
+    // The NUMA nodes of the machine
+    std::vector<int> nodes;
+    // The NUMA node of each CPU (-1 when unknown)
+    std::vector<int> node_of_cpu;
+    // The CPUs that the process may run on
+    std::vector<int> cpus;
+
+    Numa() {
+#ifdef __linux__
+        std::ifstream possible("/sys/devices/system/node/possible");
+        std::string list;
+        if (possible >> list) {
+            nodes = parse_id_list(list);
+        }
+        for (int node: nodes) {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (cpulist >> list) {
+                for (int cpu: parse_id_list(list)) {
+                    if (cpu >= static_cast<int>(node_of_cpu.size())) {
+                        node_of_cpu.resize(cpu + 1, -1);
+                    }
+                    node_of_cpu[cpu] = node;
+                }
+            }
+        }
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &cpuset)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+#endif
+    }
+
+    bool isNuma() const {
+        return nodes.size() > 1;
+    }
+
+    int threadCpu(uint64_t thread_id) const {
+        return cpus.empty() ? -1 : cpus[thread_id % cpus.size()];
+    }
+
+    // The NUMA node of the kernel thread `thread_id` or -1 if unknown
+    int threadNode(uint64_t thread_id) const {
+        const int cpu = threadCpu(thread_id);
+        return cpu < 0 or cpu >= static_cast<int>(node_of_cpu.size()) ? -1 : node_of_cpu[cpu];
+    }
+
+    // Place the pages of a new mapping, which haven't been touched yet, according to `policy`
+    void place(void *data, uint64_t nbytes, uint64_t page_size) const {
+        if (policy == BH_NUMA_NONE or not isNuma()) {
+            return;
+        }
+        if (policy == BH_NUMA_INTERLEAVE) {
+            bind(data, nbytes, BH_MPOL_INTERLEAVE, nodes);
+            return;
+        }
+        // Let's prefer the node of the thread of each part of the static schedule, where consecutive parts
+        // on the same node are placed together
+        const uint64_t npages = nbytes / page_size;
+        uint64_t begin = 0;
+        int begin_node = threadNode(0);
+        for (uint64_t t = 1; t <= num_threads; ++t) {
+            const uint64_t end = t == num_threads ? npages : npages * t / num_threads;
+            const int node = t == num_threads ? -2 : threadNode(t);
+            if (node != begin_node) {
+                if (end > begin and begin_node >= 0) {
+                    bind(static_cast<char*>(data) + begin * page_size, (end - begin) * page_size,
+                         BH_MPOL_PREFERRED, {begin_node});
+                }
+                begin = end;
+                begin_node = node;
+            }
+        }
+    }
+
+private:
+    // Set the memory policy of the address range. It is just an optimization thus we ignore errors.
+    static void bind(void *addr, uint64_t nbytes, int mode, const std::vector<int> &node_list) {
+#if defined(__linux__) && defined(SYS_mbind)
+        constexpr int BITS = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask(1);
+        for (int node: node_list) {
+            if (node / BITS >= static_cast<int>(mask.size())) {
+                mask.resize(node / BITS + 1, 0);
+            }
+            mask[node / BITS] |= 1ul << (node % BITS);
+        }
+        // NB: the kernel expects the number of bits plus one
+        syscall(SYS_mbind, addr, nbytes, mode, &mask[0], mask.size() * BITS + 1, 0);
+#endif
+    }
+};
+
+/* Map a block backed by an unlinked file in `dir`, which makes it possible to allocate more memory than RAM.
+ * The OS writes the pages back to the file under memory pressure and removes the file when it is closed.
+ */
+void *map_file_block(const std::string &dir, uint64_t nbytes, int *fd) {
+    std::string path = dir + "/bh_spill_XXXXXX";
+    *fd = mkstemp(&path[0]);
+    if (*fd < 0) {
+        return NULL;
+    }
+    unlink(path.c_str());
+    void *data = MAP_FAILED;
+    if (ftruncate(*fd, static_cast<off_t>(nbytes)) == 0) {
+        data = mmap(0, nbytes, PROT_READ|PROT_WRITE, MAP_SHARED, *fd, 0);
+    }
+    if (data == MAP_FAILED) {
+        close(*fd);
+        return NULL;
+    }
+    return data;
+}
+
+// Find the file-backed block `data`, returns false if `data` isn't file-backed
+bool find_file_block(MemoryPool &p, const void *data, MemoryPool::FileBlock *block) {
+    std::lock_guard<std::mutex> lock(p.mutex);
+    auto it = p.file_backed.find(const_cast<void*>(data));
+    if (it == p.file_backed.end()) {
+        return false;
+    }
+    *block = it->second;
+    return true;
+}
+
+Numa &numa() {
+    static Numa *ret = new Numa();
+    return *ret;
+}
+
+void *map_block(uint64_t nbytes) {
+    //Allocate page-size aligned memory.
+    //The MAP_PRIVATE and MAP_ANONYMOUS flags is not 100% portable. See:
+    //<http://stackoverflow.com/questions/4779188/how-to-use-mmap-to-allocate-a-memory-in-heap>
+    void* data = mmap(0, nbytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED)
+        return NULL;
+    else
+        return data;
+}
+}
+#endif
+
+/* Allocate an alligned contigous block of memory,
+ * does not apply any initialization
+ *
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+void* bh_memory_malloc(int64_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, BH_MEMORY_ALIGNMENT);
+#else
+    MemoryPool &p = pool();
+    const uint64_t nbytes = p.sizeClass(size);
+    // Blocks that are too large to be anonymous memory (or that cannot be) are backed by a file
+    const auto spill = [&p, nbytes]() -> void* {
+        std::string dir;
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            dir = p.spill_dir;
+        }
+        int fd;
+        void *data = dir.empty() ? NULL : map_file_block(dir, nbytes, &fd);
+        if (data != NULL) {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            p.file_backed[data] = {fd, nbytes};
+            p.stat.spilled += nbytes;
+            if (p.stat.spilled > p.stat.max_spilled) {
+                p.stat.max_spilled = p.stat.spilled;
+            }
+        }
+        return data;
+    };
+    if (p.spill_threshold > 0 and nbytes >= p.spill_threshold) {
+        void *data = spill();
+        if (data != NULL) {
+            return data;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        auto it = p.free_blocks.find(nbytes);
+        if (it != p.free_blocks.end() and not it->second.empty()) {
+            void *data = it->second.back();
+            it->second.pop_back();
+            p.stat.retained -= nbytes;
+            ++p.stat.hits;
+            p.allocated[data] = nbytes;
+            return data;
+        }
+        ++p.stat.misses;
+    }
+
+    void *data = map_block(nbytes);
+    if (data == NULL) { // Let's release the retained memory and try again
+        {
+            std::lock_guard<std::mutex> lock(p.mutex);
+            p.trim(0);
+        }
+        data = map_block(nbytes);
+        if (data == NULL) {
+            return spill();
+        }
+    }
+    numa().place(data, nbytes, p.page_size);
+#ifdef MADV_HUGEPAGE
+    if (p.hugepage_threshold > 0 and nbytes >= p.hugepage_threshold) {
+        madvise(data, nbytes, MADV_HUGEPAGE); // Just an advice thus we ignore errors
+    }
+#endif
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.allocated[data] = nbytes;
+    return data;
+#endif
+}
+
+/* Frees a previously allocated data block
+ *
+ * @data  The pointer returned from a call to bh_memory_malloc
+ * @size  The size of the allocated block
+ * @return A pointer to data, and NULL on error
+ */
+int64_t bh_memory_free(void* data, int64_t size)
+{
+#ifdef _WIN32
+	_aligned_free(data);
+	return 0;
+#else
+    MemoryPool &p = pool();
+    const uint64_t nbytes = p.sizeClass(size);
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        auto file = p.file_backed.find(data);
+        if (file != p.file_backed.end()) {
+            const MemoryPool::FileBlock block = file->second;
+            p.file_backed.erase(file);
+            p.stat.spilled -= block.nbytes;
+            const int ret = munmap(data, block.nbytes);
+            close(block.fd);
+            return ret;
+        }
+        auto it = p.allocated.find(data);
+        // NB: blocks not allocated by the pool (e.g. memory handed over by a bridge) are simply unmapped
+        if (it != p.allocated.end()) {
+            const bool match = it->second == nbytes;
+            p.allocated.erase(it);
+            if (match and p.stat.retained + nbytes <= p.max_retained) {
+                p.free_blocks[nbytes].push_back(data);
+                p.stat.retained += nbytes;
+                if (p.stat.retained > p.stat.max_retained) {
+                    p.stat.max_retained = p.stat.retained;
+                }
+                return 0;
+            }
+        }
+    }
+	return munmap(data, size);
+#endif
+}
+
+/* Configure the memory pool of bh_memory_malloc() and bh_memory_free()
+ *
+ * @max_retained        The maximum number of bytes of freed memory to retain for reuse (0 disables the pool)
+ * @hugepage_threshold  Blocks of this size or larger are advised to use huge pages (0 disables)
+ */
+void bh_memory_pool_config(uint64_t max_retained, uint64_t hugepage_threshold)
+{
+#ifndef _WIN32
+    MemoryPool &p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.max_retained = max_retained;
+    p.hugepage_threshold = hugepage_threshold;
+    p.trim(max_retained);
+#endif
+}
+
+/* Returns the statistics of the memory pool
+ *
+ * @return The statistics
+ */
+bh_memory_pool_stat bh_memory_pool_stats(void)
+{
+#ifdef _WIN32
+    bh_memory_pool_stat ret = {0, 0, 0, 0, 0, 0};
+    return ret;
+#else
+    MemoryPool &p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return p.stat;
+#endif
+}
+
+/* Configure the NUMA placement of bh_memory_malloc()
+ *
+ * @policy       The placement policy
+ * @num_threads  The number of kernel threads of the static schedule
+ */
+void bh_memory_numa_config(bh_numa_policy policy, uint64_t num_threads)
+{
+#ifndef _WIN32
+    Numa &n = numa();
+    n.policy = policy;
+    n.num_threads = num_threads > 0 ? num_threads : 1;
+#endif
+}
+
+/* Returns the CPU that kernel thread `thread_id` should be pinned to
+ *
+ * @thread_id  The ID of the kernel thread
+ * @return     The CPU or -1 if unknown
+ */
+int bh_memory_numa_thread_cpu(uint64_t thread_id)
+{
+#ifdef _WIN32
+    return -1;
+#else
+    return numa().threadCpu(thread_id);
+#endif
+}
+
+/* Samples the NUMA placement of the pages of a block returned by bh_memory_malloc()
+ *
+ * @data         The pointer returned from a call to bh_memory_malloc
+ * @num_threads  The number of kernel threads of the static schedule
+ * @sampled      Incremented by the number of sampled pages
+ * @remote       Incremented by the number of sampled pages that are remote
+ */
+void bh_memory_numa_sample(const void *data, uint64_t num_threads, uint64_t *sampled, uint64_t *remote)
+{
+#if defined(__linux__) && defined(SYS_move_pages)
+    const Numa &n = numa();
+    if (not n.isNuma() or data == NULL or num_threads == 0) {
+        return;
+    }
+    MemoryPool &p = pool();
+    uint64_t nbytes;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        auto it = p.allocated.find(const_cast<void*>(data));
+        if (it == p.allocated.end()) {
+            return;
+        }
+        nbytes = it->second;
+    }
+    // Let's sample a handful of pages evenly spread over the block
+    constexpr uint64_t MAX_SAMPLES = 16;
+    const uint64_t npages = nbytes / p.page_size;
+    const uint64_t nsamples = npages < MAX_SAMPLES ? npages : MAX_SAMPLES;
+    std::vector<void*> pages(nsamples);
+    std::vector<int> status(nsamples, -1);
+    for (uint64_t i = 0; i < nsamples; ++i) {
+        pages[i] = static_cast<char*>(const_cast<void*>(data)) + (i * npages / nsamples) * p.page_size;
+    }
+    // NB: without a list of target nodes, move_pages() returns the node of each page in `status`
+    if (nsamples == 0 or syscall(SYS_move_pages, 0, nsamples, &pages[0], NULL, &status[0], 0) != 0) {
+        return;
+    }
+    for (uint64_t i = 0; i < nsamples; ++i) {
+        if (status[i] < 0) { // The page hasn't been touched or the OS doesn't know
+            continue;
+        }
+        const uint64_t offset = static_cast<const char*>(pages[i]) - static_cast<const char*>(data);
+        const uint64_t thread = static_cast<uint64_t>(static_cast<double>(offset) / nbytes * num_threads);
+        const int expected = n.threadNode(thread);
+        ++*sampled;
+        if (expected >= 0 and status[i] != expected) {
+            ++*remote;
+        }
+    }
+#endif
+}
+
+/* Configure the file-backed blocks of bh_memory_malloc()
+ *
+ * @spill_dir  The directory of the files (NULL or empty disables file-backed blocks)
+ * @threshold  Blocks of this size or larger are file-backed (0 means only when anonymous memory runs out)
+ */
+void bh_memory_spill_config(const char *spill_dir, uint64_t threshold)
+{
+#ifndef _WIN32
+    MemoryPool &p = pool();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.spill_dir = spill_dir == NULL ? "" : spill_dir;
+    p.spill_threshold = p.spill_dir.empty() ? 0 : threshold;
+#endif
+}
+
+/* Hint that a range of a block returned by bh_memory_malloc() will be accessed soon,
+ * which makes the OS read the range of a file-backed block ahead
+ *
+ * @data    The pointer returned from a call to bh_memory_malloc
+ * @offset  The offset of the range in bytes
+ * @nbytes  The size of the range in bytes
+ */
+void bh_memory_spill_prefetch(const void *data, uint64_t offset, uint64_t nbytes)
+{
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+    MemoryPool &p = pool();
+    MemoryPool::FileBlock block;
+    if (not find_file_block(p, data, &block) or offset >= block.nbytes) {
+        return;
+    }
+    const uint64_t begin = offset / p.page_size * p.page_size;
+    const uint64_t end = std::min(block.nbytes, p.sizeClass(offset + nbytes));
+    madvise(static_cast<char*>(const_cast<void*>(data)) + begin, end - begin, MADV_WILLNEED);
+#endif
+}
+
+/* Write a range of a file-backed block returned by bh_memory_malloc() back to its file and
+ * release its memory. Blocks that aren't file-backed are ignored.
+ *
+ * @data    The pointer returned from a call to bh_memory_malloc
+ * @offset  The offset of the range in bytes
+ * @nbytes  The size of the range in bytes
+ */
+void bh_memory_spill_evict(const void *data, uint64_t offset, uint64_t nbytes)
+{
+#ifndef _WIN32
+    MemoryPool &p = pool();
+    MemoryPool::FileBlock block;
+    if (not find_file_block(p, data, &block) or offset >= block.nbytes) {
+        return;
+    }
+    // NB: only whole pages within the range are released since the rest might belong to the next range
+    const uint64_t begin = p.sizeClass(offset);
+    const uint64_t end = offset + nbytes >= block.nbytes ? block.nbytes
+                                                          : (offset + nbytes) / p.page_size * p.page_size;
+    if (end <= begin) {
+        return;
+    }
+    char *addr = static_cast<char*>(const_cast<void*>(data)) + begin;
+    msync(addr, end - begin, MS_SYNC);
+    madvise(addr, end - begin, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(block.fd, static_cast<off_t>(begin), static_cast<off_t>(end - begin), POSIX_FADV_DONTNEED);
+#endif
+#endif
+}
@@ -22,6 +22,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <jitk/apply_fusion.hpp>
 #include <jitk/graph.hpp>
+#include <jitk/cost_model.hpp>
 
 using namespace std;
 
@@ -48,13 +49,21 @@ vector<Block> apply_pre_fusion(const ConfigParser &config, const vector<bh_instr
 void apply_transformers(const ConfigParser &config, vector<Block> &block_list, const vector<string> &transformer_names,
                         bool avoid_rank0_sweep) {
 
+    // The cost model that prioritizes the merges of the greedy fusers
+    const unique_ptr<CostModel> cost_model = create_cost_model(config);
+
     for(auto it = transformer_names.begin(); it != transformer_names.end(); ++it) {
         if (*it == "push_reductions_inwards") {
             push_reductions_inwards(block_list);
+        } else if (*it == "push_unit_strides_inwards") {
+            push_unit_strides_inwards(block_list);
         } else if (*it == "split_for_threading") {
             split_for_threading(block_list);
         } else if (*it == "collapse_redundant_axes") {
             collapse_redundant_axes(block_list);
+        } else if (*it == "tile") {
+            tile(block_list, config.defaultGet<uint64_t>("tile_size", 0),
+                 config.defaultGet<uint64_t>("tile_cache_size", 0));
         } else if (*it == "serial") {
             fuser_serial(block_list, avoid_rank0_sweep);
         } else if (*it == "breadth_first") {
@@ -62,7 +71,9 @@ void apply_transformers(const ConfigParser &config, vector<Block> &block_list, c
         } else if (*it == "reshapable_first") {
             fuser_reshapable_first(block_list, avoid_rank0_sweep);
         } else if (*it == "greedy") {
-            fuser_greedy(config, block_list, avoid_rank0_sweep);
+            fuser_greedy(config, *cost_model, block_list, avoid_rank0_sweep);
+        } else if (*it == "sibling") {
+            fuser_sibling(*cost_model, block_list, avoid_rank0_sweep);
         } else {
             cout << "Unknown transformer: \"" << *it << "\"" << endl;
             throw runtime_error("Unknown transformer!");
@@ -349,6 +349,9 @@ string LoopB::pprint(const char *newline) const {
     if (_reshapable) {
         ss << ", reshapable";
     }
+    if (tile > 0) {
+        ss << ", tile: " << tile;
+    }
     if (_news.size() > 0) {
         ss << ", news: {";
         for (const bh_base *b : _news) {
@@ -548,6 +551,28 @@ vector<const LoopB*> get_first_loop_blocks(const LoopB &block) {
     return ret;
 }
 
+vector<const LoopB*> get_tiled_loops(const LoopB &block) {
+    // NB: the `tile()` transformer only tiles perfectly nested loops thus they are all first sub-blocks
+    vector<const LoopB*> ret;
+    for (const LoopB *loop: get_first_loop_blocks(block)) {
+        if (loop->tile > 0) {
+            ret.push_back(loop);
+        }
+    }
+    return ret;
+}
+
+vector<const LoopB*> get_all_loop_blocks(const vector<Block> &block_list) {
+    vector<const LoopB*> ret;
+    for (const Block &block: block_list) {
+        if (not block.isInstr()) {
+            ret.push_back(&block.getLoop());
+            block.getLoop().getAllSubBlocks(ret);
+        }
+    }
+    return ret;
+}
+
 // Unnamed namespace for all some merge help functions
 namespace {
 
@@ -21,7 +21,10 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <iostream>
 
+#include <boost/filesystem/operations.hpp>
+
 #include <jitk/codegen_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 using namespace std;
 
@@ -74,14 +77,20 @@ void hash_stream(const bh_instruction &instr, const SymbolTable &symbols, std::s
 }
 
 /* The Block hash consists of the following fields:
- * <block_rank><instr_hash><SEP_BLOCK>
+ * <block_rank><block_size><block_tile><instr_hash><SEP_BLOCK>
+ * NB: the block size is excluded when `shape_as_var` is set
  */
 void hash_stream(const Block &block, const SymbolTable &symbols, std::stringstream &ss) {
     if (block.isInstr()) {
         hash_stream(*block.getInstr(), symbols, ss);
     } else {
         ss << "rank: " << block.rank();
-        ss << "size: " << block.getLoop().size;
+        if (not symbols.shape_as_var) {
+            ss << "size: " << block.getLoop().size;
+        }
+        if (block.getLoop().tile > 0) {
+            ss << "tile: " << block.getLoop().tile;
+        }
         for (const Block &b: block.getLoop()._block_list) {
             hash_stream(b, symbols, ss);
         }
@@ -89,16 +98,42 @@ void hash_stream(const Block &block, const SymbolTable &symbols, std::stringstre
 }
 
 /* The Block list hash consists of the following fields:
- * <block_rank><SEP_BLOCK>
+ * <offsets_as_var><assume_aligned><strip>(<block_rank><SEP_BLOCK>)*
  */
 uint64_t block_list_hash(const std::vector<Block> &block_list, const SymbolTable &symbols) {
     stringstream ss;
+    if (symbols.offsets_as_var) {
+        ss << "offsets";
+    }
+    if (symbols.assumeAligned()) {
+        ss << "aligned";
+    }
+    if (symbols.strip.rows > 0) {
+        ss << "strip: " << symbols.strip.rows << "," << symbols.strip.size << "," << symbols.strip.steps;
+        for (const auto &extent: symbols.strip.extents) {
+            ss << "[" << extent.first << "," << extent.second << "]";
+        }
+        for (const StripMine::Window &window: symbols.strip.windows) {
+            ss << "(" << window.offset << "," << window.rows << "," << window.row_elems << ")";
+        }
+    }
     for (const Block &b: block_list) {
         hash_stream(b, symbols, ss);
         ss << "<block>";
     }
     return util::hash(ss.str());
 }
+
+/* The persistent cache entry consists of the following fields:
+ * <CODEGEN_CACHE_HEADER><lookup_hash>\n<source>
+ */
+constexpr char CODEGEN_CACHE_HEADER[] = "// bohrium codegen cache v2: ";
+
+string persistent_entry(const string &source, uint64_t lookup_hash) {
+    stringstream ss;
+    ss << CODEGEN_CACHE_HEADER << lookup_hash << "\n" << source;
+    return ss.str();
+}
 } // Anonymous Namespace
 
 std::pair<std::string, uint64_t> CodegenCache::get(const std::vector<Block> &block_list, const SymbolTable &symbols) {
@@ -107,15 +142,33 @@ std::pair<std::string, uint64_t> CodegenCache::get(const std::vector<Block> &blo
     auto lookup = _cache.find(lookup_hash);
     if (lookup != _cache.end()) { // Cache hit!
         return make_pair(lookup->second, lookup_hash);
-    } else {
-        ++stat.codegen_cache_misses;
-        return make_pair("", lookup_hash);
     }
+    if (not _persist_dir.empty()) { // Let's check the persistent cache
+        const string data = read_file(_persist_dir / hash_filename(_persist_hash, lookup_hash, ".codegen"));
+        const string header = persistent_entry("", lookup_hash);
+        if (data.size() > header.size() and data.compare(0, header.size(), header) == 0) {
+            string &source = _cache[lookup_hash];
+            source = data.substr(header.size());
+            return make_pair(source, lookup_hash);
+        }
+    }
+    ++stat.codegen_cache_misses;
+    return make_pair("", lookup_hash);
 }
 
 void CodegenCache::insert(std::string source, const std::vector<Block> &block_list, const SymbolTable &symbols) {
     const uint64_t lookup_hash = block_list_hash(block_list, symbols);
     assert(_cache.find(lookup_hash) == _cache.end()); // The source shouldn't exist in the cache already
+    if (not _persist_dir.empty()) {
+        const boost::filesystem::path filename = _persist_dir / hash_filename(_persist_hash, lookup_hash, ".codegen");
+        try {
+            if (not boost::filesystem::exists(filename)) {
+                write_file_atomically(persistent_entry(source, lookup_hash), filename);
+            }
+        } catch (const std::exception &e) {
+            cout << "Warning: couldn't write codegen cache file " << filename << ": " << e.what() << endl;
+        }
+    }
     _cache[lookup_hash] = std::move(source);
 }
 
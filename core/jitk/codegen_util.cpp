@@ -19,7 +19,14 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <limits>
+#include <fstream>
 #include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <dlfcn.h>
+#include <cstring>
+#include <cerrno>
 #include <boost/filesystem/operations.hpp>
 #include <jitk/codegen_util.hpp>
 #include <jitk/view.hpp>
@@ -52,6 +59,77 @@ boost::filesystem::path write_source2file(const std::string &src,
     return srcfile;
 }
 
+void write_file_atomically(const std::string &data, const boost::filesystem::path &path) {
+    boost::filesystem::path tmpfile = path;
+    tmpfile += boost::filesystem::unique_path(".%%%%-%%%%.tmp");
+    {
+        ofstream ofs(tmpfile.string(), ios::binary);
+        ofs << data;
+        if (not ofs) {
+            throw runtime_error("Couldn't write " + tmpfile.string());
+        }
+    }
+    boost::filesystem::rename(tmpfile, path);
+}
+
+std::string read_file(const boost::filesystem::path &path) {
+    ifstream ifs(path.string(), ios::binary);
+    if (not ifs) {
+        return string();
+    }
+    stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+void copy_file_atomically(const boost::filesystem::path &src, const boost::filesystem::path &dst) {
+    boost::filesystem::path tmpfile = dst;
+    tmpfile += boost::filesystem::unique_path(".%%%%-%%%%.tmp");
+    boost::filesystem::copy_file(src, tmpfile);
+    boost::filesystem::rename(tmpfile, dst);
+}
+
+uint64_t file_build_hash(const boost::filesystem::path &path, uint64_t seed) {
+    boost::system::error_code ec;
+    const uintmax_t size = boost::filesystem::file_size(path, ec);
+    if (ec) {
+        return seed;
+    }
+    const time_t mtime = boost::filesystem::last_write_time(path, ec);
+    stringstream ss;
+    ss << path.string() << ":" << size << ":" << mtime;
+    return util::hash(ss.str(), seed);
+}
+
+uint64_t build_hash(const boost::filesystem::path &library, uint64_t seed) {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void *>(&build_hash), &info) != 0 and info.dli_fname != nullptr) {
+        seed = file_build_hash(info.dli_fname, seed);
+    }
+    return file_build_hash(library, seed);
+}
+
+FileLock::FileLock(boost::filesystem::path path) : _path(std::move(path)) {
+    _fd = open(_path.string().c_str(), O_RDWR | O_CREAT, 0666);
+    if (_fd == -1) {
+        throw runtime_error("FileLock: cannot open " + _path.string() + ": " + strerror(errno));
+    }
+    while (flock(_fd, LOCK_EX) == -1) {
+        if (errno != EINTR) {
+            close(_fd);
+            throw runtime_error("FileLock: cannot lock " + _path.string() + ": " + strerror(errno));
+        }
+    }
+}
+
+FileLock::~FileLock() {
+    // NB: we remove the lock file before releasing the lock thus processes that open the lock file from now on
+    //     will not wait on this lock
+    boost::system::error_code ec;
+    boost::filesystem::remove(_path, ec);
+    close(_fd);
+}
+
 boost::filesystem::path get_tmp_path(const ConfigParser &config) {
     boost::filesystem::path tmp_path;
     const boost::filesystem::path tmp_dir = config.defaultGet<boost::filesystem::path>("tmp_dir", "");
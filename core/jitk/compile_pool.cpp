@@ -0,0 +1,137 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <jitk/compile_pool.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+CompilePool::CompilePool(unsigned int num_workers) {
+    for (unsigned int i = 0; i < num_workers; ++i) {
+        _workers.emplace_back(&CompilePool::worker, this);
+    }
+}
+
+void CompilePool::run(Job &job) {
+    const auto tstart = chrono::steady_clock::now();
+    try {
+        job.func();
+    } catch (...) {
+        job.error = current_exception();
+    }
+    job.time = chrono::steady_clock::now() - tstart;
+}
+
+void CompilePool::worker() {
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _cond_queue.wait(lock, [this] { return _shutdown or not _queue.empty(); });
+        if (_shutdown) {
+            return;
+        }
+        const uint64_t key = _queue.front();
+        _queue.pop_front();
+
+        // The job might have been collected (and run) by `wait()` in the meantime
+        auto it = _jobs.find(key);
+        if (it == _jobs.end() or it->second->state != Job::State::QUEUED) {
+            continue;
+        }
+        shared_ptr<Job> job = it->second;
+        job->state = Job::State::RUNNING;
+        lock.unlock();
+        run(*job);
+        lock.lock();
+        job->state = Job::State::DONE;
+        _cond_done.notify_all();
+    }
+}
+
+void CompilePool::submit(uint64_t key, function<void()> job) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_shutdown or _jobs.find(key) != _jobs.end()) {
+            return;
+        }
+        _jobs[key] = make_shared<Job>();
+        _jobs[key]->func = std::move(job);
+        _queue.push_back(key);
+    }
+    _cond_queue.notify_one();
+}
+
+bool CompilePool::exist(uint64_t key) const {
+    lock_guard<mutex> lock(_mutex);
+    return _jobs.find(key) != _jobs.end();
+}
+
+bool CompilePool::ready(uint64_t key) const {
+    lock_guard<mutex> lock(_mutex);
+    auto it = _jobs.find(key);
+    return it != _jobs.end() and it->second->state == Job::State::DONE;
+}
+
+chrono::duration<double> CompilePool::wait(uint64_t key) {
+    unique_lock<mutex> lock(_mutex);
+    auto it = _jobs.find(key);
+    if (it == _jobs.end()) {
+        return chrono::duration<double>{0};
+    }
+    shared_ptr<Job> job = it->second;
+    _jobs.erase(it);
+
+    chrono::duration<double> hidden{0};
+    if (job->state == Job::State::QUEUED) {
+        // No worker got to the job yet, so we run it ourselves. Nothing is hidden.
+        job->state = Job::State::RUNNING;
+        lock.unlock();
+        run(*job);
+    } else {
+        const auto twait = chrono::steady_clock::now();
+        _cond_done.wait(lock, [&job] { return job->state == Job::State::DONE; });
+        const chrono::duration<double> waited = chrono::steady_clock::now() - twait;
+        if (job->time > waited) {
+            hidden = job->time - waited;
+        }
+    }
+    if (job->error) {
+        rethrow_exception(job->error);
+    }
+    return hidden;
+}
+
+void CompilePool::shutdown() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _shutdown = true;
+        _queue.clear();
+    }
+    _cond_queue.notify_all();
+    for (thread &t: _workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    _workers.clear();
+}
+
+}} // namespace
@@ -0,0 +1,140 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <thread>
+
+#include <bh_util.hpp>
+#include <jitk/cost_model.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+BlockTraffic block_traffic(const Block &block, uint64_t cache_line) {
+    BlockTraffic ret;
+    set<bh_base *> temps;
+    if (not block.isInstr()) {
+        const LoopB &loop = block.getLoop();
+        loop.getAllTemps(temps);
+        loop.getAllNews(ret.news);
+        loop.getAllFrees(ret.frees);
+        ret.threading = std::max(parallel_ranks(loop).second, uint64_t{1});
+    }
+    for (const InstrPtr &instr: block.getAllInstr()) {
+        int64_t max_nelem = 0;
+        for (const bh_view &view: instr->operand) {
+            if (bh_is_constant(&view) or util::exist(temps, view.base)) {
+                continue;
+            }
+            const int64_t nelem = bh_nelements(view);
+            max_nelem = std::max(max_nelem, nelem);
+
+            // A strided access transfers up to a cache line per element
+            const uint64_t itemsize = static_cast<uint64_t>(bh_type_size(view.base->type));
+            const uint64_t stride = view.ndim > 0 ? static_cast<uint64_t>(std::abs(view.stride[view.ndim - 1])) : 1;
+            uint64_t access = itemsize;
+            if (stride > 1) {
+                access = std::min(stride * itemsize, std::max(cache_line, itemsize));
+            }
+            uint64_t &bytes = ret.bytes[view.base];
+            bytes = std::max(bytes, static_cast<uint64_t>(nelem) * access);
+        }
+        if (instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+            ret.indirect += static_cast<uint64_t>(max_nelem);
+        }
+    }
+    return ret;
+}
+
+BlockTraffic merge_traffic(const BlockTraffic &t1, const BlockTraffic &t2) {
+    BlockTraffic ret = t1;
+    // Arrays accessed by both blocks are only transferred once
+    for (const auto &base_bytes: t2.bytes) {
+        uint64_t &bytes = ret.bytes[base_bytes.first];
+        bytes = std::max(bytes, base_bytes.second);
+    }
+    ret.news.insert(t2.news.begin(), t2.news.end());
+    ret.frees.insert(t2.frees.begin(), t2.frees.end());
+    // Arrays created and freed within the merged block become temporary arrays, which are never transferred
+    for (bh_base *base: ret.news) {
+        if (util::exist(ret.frees, base)) {
+            ret.bytes.erase(base);
+        }
+    }
+    ret.threading = std::min(t1.threading, t2.threading);
+    ret.indirect = t1.indirect + t2.indirect;
+    return ret;
+}
+
+double BytesCostModel::cost(const BlockTraffic &traffic) const {
+    uint64_t totalsize = 0;
+    for (const auto &base_bytes: traffic.bytes) {
+        totalsize += base_bytes.second;
+    }
+    return static_cast<double>(totalsize);
+}
+
+TrafficCostModel::TrafficCostModel(const ConfigParser &config) :
+        dram_bandwidth(config.defaultGet<double>("machine_dram_bandwidth", 10e9)),
+        cache_bandwidth(config.defaultGet<double>("machine_cache_bandwidth", 50e9)),
+        cache_size(config.defaultGet<uint64_t>("machine_cache_size", 8 * 1024 * 1024)),
+        cache_line(config.defaultGet<uint64_t>("machine_cache_line", 64)),
+        memory_latency(config.defaultGet<double>("machine_memory_latency", 100e-9)),
+        parallel_overhead(config.defaultGet<double>("machine_parallel_overhead", 5e-6)),
+        num_threads(config.defaultGet<uint64_t>("machine_threads", 0) > 0 ?
+                    config.defaultGet<uint64_t>("machine_threads", 0) :
+                    std::max(static_cast<uint64_t>(std::thread::hardware_concurrency()), uint64_t{1})),
+        max_streams(std::max(config.defaultGet<uint64_t>("cost_max_streams", 16), uint64_t{1})) {}
+
+double TrafficCostModel::cost(const BlockTraffic &traffic) const {
+    uint64_t bytes = 0, working_set = 0;
+    for (const auto &base_bytes: traffic.bytes) {
+        bytes += base_bytes.second;
+        working_set += static_cast<uint64_t>(bh_base_size(base_bytes.first));
+    }
+    // Arrays that fit in the cache are transferred at the bandwidth of the cache
+    const double bandwidth = working_set <= cache_size ? cache_bandwidth : dram_bandwidth;
+    double time = bytes / bandwidth + traffic.indirect * memory_latency / num_threads;
+
+    // Streaming more arrays than the hardware can keep track of slows down the block
+    if (traffic.bytes.size() > max_streams) {
+        time *= static_cast<double>(traffic.bytes.size()) / max_streams;
+    }
+    // A block with less parallelism than threads cannot use the full machine
+    const double efficiency = std::min(1.0, static_cast<double>(traffic.threading) / num_threads);
+    return time / efficiency + parallel_overhead;
+}
+
+unique_ptr<CostModel> create_cost_model(const ConfigParser &config) {
+    const string name = config.defaultGet<string>("cost_model", "traffic");
+    if (name == "traffic") {
+        return unique_ptr<CostModel>(new TrafficCostModel(config));
+    } else if (name == "bytes") {
+        return unique_ptr<CostModel>(new BytesCostModel());
+    } else {
+        cout << "Unknown cost model: \"" << name << "\"" << endl;
+        throw runtime_error("Unknown cost model!");
+    }
+}
+
+} // jitk
+} // bohrium
@@ -375,23 +375,38 @@ void fuser_reshapable_first(vector<Block> &block_list, bool avoid_rank0_sweep) {
     block_list = ret;
 }
 
-void fuser_greedy(const ConfigParser &config, vector<Block> &block_list, bool avoid_rank0_sweep) {
+void fuser_greedy(const ConfigParser &config, const CostModel &cost_model, vector<Block> &block_list,
+                  bool avoid_rank0_sweep) {
 
     graph::DAG dag = graph::from_block_list(block_list);
 
+    // NB: a threshold of zero means no threshold
     size_t greedy_threshold = config.defaultGet<size_t>("greedy_threshold", 10000);
-    if (boost::num_edges(dag) > greedy_threshold) {
+    if (greedy_threshold > 0 and boost::num_edges(dag) > greedy_threshold) {
         fuser_reshapable_first(block_list, avoid_rank0_sweep);
         return;
     }
 
-    graph::greedy(dag, avoid_rank0_sweep);
-    vector<Block> ret = graph::fill_block_list(dag);
+    vector<Block> ret = graph::greedy(dag, cost_model, avoid_rank0_sweep);
 
     // Let's fuse at the next rank level
     for (Block &b: ret) {
         if (not b.isInstr()) {
-            fuser_greedy(config, b.getLoop()._block_list, avoid_rank0_sweep);
+            fuser_greedy(config, cost_model, b.getLoop()._block_list, avoid_rank0_sweep);
+        }
+    }
+    block_list = ret;
+}
+
+void fuser_sibling(const CostModel &cost_model, vector<Block> &block_list, bool avoid_rank0_sweep) {
+
+    const graph::DAG dag = graph::from_block_list(block_list);
+    vector<Block> ret = graph::sibling(dag, cost_model, avoid_rank0_sweep);
+
+    // Let's fuse at the next rank level
+    for (Block &b: ret) {
+        if (not b.isInstr()) {
+            fuser_sibling(cost_model, b.getLoop()._block_list, avoid_rank0_sweep);
         }
     }
     block_list = ret;
@@ -20,8 +20,12 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <iostream>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/filesystem/operations.hpp>
 
 #include <jitk/fuser_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 
 using namespace std;
@@ -135,12 +139,119 @@ void update_with_origin(Block &block, const map<int64_t, const bh_instruction *>
     }
 }
 
+/* The persistent cache entry consists of the following fields:
+ * <FUSE_CACHE_MAGIC><FUSE_CACHE_VERSION><lookup_hash><number of blocks>[<block>...]
+ * where each block is saved recursively by `save_block()`.
+ * Notice, the base array pointers are saved as is since `update_with_origin()` replaces them on cache hits.
+ */
+constexpr uint64_t FUSE_CACHE_MAGIC = 0x6268667573650000; // "bhfuse"
+constexpr uint32_t FUSE_CACHE_VERSION = 2;
+
+void save_block(boost::archive::binary_oarchive &oa, const Block &block) {
+    const bool is_instr = block.isInstr();
+    oa << is_instr;
+    const int rank = block.rank();
+    oa << rank;
+    if (is_instr) {
+        const bh_instruction &instr = *block.getInstr();
+        oa << instr; // The opcode, the operands, and the constant
+        oa << instr.origin_id;
+        oa << instr.constructor;
+    } else {
+        const LoopB &loop = block.getLoop();
+        oa << loop.size;
+        oa << loop.tile;
+        const uint64_t num_blocks = loop._block_list.size();
+        oa << num_blocks;
+        for (const Block &b: loop._block_list) {
+            save_block(oa, b);
+        }
+    }
+}
+
+Block load_block(boost::archive::binary_iarchive &ia) {
+    bool is_instr;
+    ia >> is_instr;
+    int rank;
+    ia >> rank;
+    if (is_instr) {
+        bh_instruction instr;
+        ia >> instr;
+        ia >> instr.origin_id;
+        ia >> instr.constructor;
+        return Block(instr, rank);
+    } else {
+        LoopB loop;
+        loop.rank = rank;
+        ia >> loop.size;
+        ia >> loop.tile;
+        uint64_t num_blocks;
+        ia >> num_blocks;
+        for (uint64_t i = 0; i < num_blocks; ++i) {
+            loop._block_list.push_back(load_block(ia));
+        }
+        // NB: the metadata is updated by `update_with_origin()`
+        return Block(std::move(loop));
+    }
+}
+
 } // Anon namespace
 
+bool FuseCache::load(size_t lookup_hash) {
+    const boost::filesystem::path filename = _persist_dir / hash_filename(_persist_hash, lookup_hash, ".fuse");
+    const string data = read_file(filename);
+    if (data.empty()) {
+        return false;
+    }
+    try {
+        stringstream ss(data);
+        boost::archive::binary_iarchive ia(ss);
+        uint64_t magic, hash;
+        uint32_t version;
+        ia >> magic >> version >> hash;
+        if (magic != FUSE_CACHE_MAGIC or version != FUSE_CACHE_VERSION or hash != lookup_hash) {
+            return false;
+        }
+        uint64_t num_blocks;
+        ia >> num_blocks;
+        vector<Block> block_list;
+        block_list.reserve(num_blocks);
+        for (uint64_t i = 0; i < num_blocks; ++i) {
+            block_list.push_back(load_block(ia));
+        }
+        _cache.insert(make_pair(lookup_hash, std::move(block_list)));
+    } catch (const boost::archive::archive_exception &e) {
+        cout << "Warning: ignoring corrupted fuse cache file " << filename << ": " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+void FuseCache::store(size_t lookup_hash, const vector<Block> &block_list) const {
+    const boost::filesystem::path filename = _persist_dir / hash_filename(_persist_hash, lookup_hash, ".fuse");
+    try {
+        if (boost::filesystem::exists(filename)) {
+            return;
+        }
+        stringstream ss;
+        {
+            boost::archive::binary_oarchive oa(ss);
+            const uint64_t num_blocks = block_list.size();
+            oa << FUSE_CACHE_MAGIC << FUSE_CACHE_VERSION << static_cast<uint64_t>(lookup_hash) << num_blocks;
+            for (const Block &b: block_list) {
+                save_block(oa, b);
+            }
+        }
+        write_file_atomically(ss.str(), filename);
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't write fuse cache file " << filename << ": " << e.what() << endl;
+    }
+}
+
 pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_list) {
     const size_t lookup_hash = hash_instr_list(instr_list);
     ++stat.fuser_cache_lookups;
-    if (_cache.find(lookup_hash) != _cache.end()) { // Cache hit!
+    if (_cache.find(lookup_hash) != _cache.end() or (not _persist_dir.empty() and load(lookup_hash))) { // Cache hit!
         vector<Block> ret = _cache.at(lookup_hash);
         // Create a map: 'origin_id' => instruction
         map<int64_t, const bh_instruction *> origin_id_to_instr;
@@ -163,6 +274,9 @@ pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_l
 void FuseCache::insert(const vector<bh_instruction *> &instr_list, const vector<Block> &block_list) {
     const size_t lookup_hash = hash_instr_list(instr_list);
     _cache.insert(make_pair(lookup_hash, block_list));
+    if (not _persist_dir.empty()) {
+        store(lookup_hash, block_list);
+    }
 }
 
 } // jitk
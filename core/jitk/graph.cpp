@@ -29,6 +29,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <queue>
 #include <cassert>
 
+#include <bh_util.hpp>
 #include <jitk/graph.hpp>
 #include <jitk/block.hpp>
 
@@ -299,52 +300,381 @@ void pprint(const DAG &dag, const char *filename, bool avoid_rank0_sweep) {
     file.close();
 }
 
-void greedy(DAG &dag, bool avoid_rank0_sweep) {
-    while(1) {
-        // First we find all fusible edges
-        vector<Edge> fusibles;
-        {
-            auto edges = boost::edges(dag);
-            for (auto it = edges.first; it != edges.second;) {
-                Edge e = *it; ++it; // NB: we iterate here because boost::remove_edge() invalidates 'it'
-                Vertex v1 = source(e, dag);
-                Vertex v2 = target(e, dag);
-                // Remove transitive edges
-                if(path_exist(v1, v2, dag, true)) {
-                    boost::remove_edge(e, dag);
-                } else {
-                    const Block &b1 = dag[v1];
-                    const Block &b2 = dag[v2];
-                    if (mergeable(b1, b2, avoid_rank0_sweep)) {
-                        fusibles.push_back(e);
+namespace {
+
+// An edge in the priority queue of the greedy fuser.
+// The entry is outdated when one of the vertices has changed since the entry was pushed (see `GreedyFuser::version`)
+struct WeightedEdge {
+    double weight;
+    Vertex src, dst;
+    uint64_t src_version, dst_version;
+
+    // The greatest weight first and then the smallest vertex IDs, which makes the fusion deterministic
+    bool operator<(const WeightedEdge &other) const {
+        if (weight != other.weight) {
+            return weight < other.weight;
+        }
+        if (src != other.src) {
+            return src > other.src;
+        }
+        return dst > other.dst;
+    }
+};
+
+/* The greedy fuser merges the greatest weight edge until no fusible edge remains.
+ * The weight of an edge is the benefit of the merge according to the cost model. Edges with a negative benefit
+ * are never merged.
+ * Rather than rescanning all edges after each merge, the fuser keeps the fusible edges in a priority queue and
+ * only pushes the edges next to the merged vertex. Outdated and transitive edges are discarded when popped.
+ *
+ * In sibling mode, the fuser merges independent vertices (no path between them) rather than edges. The candidates
+ * are the pairs of vertices that read the same non-temporary arrays.
+ *
+ * In order to find transitive edges (i.e. a path of length greater than one exist between the two vertices) fast,
+ * we maintain a topological order of the vertices incrementally using the Pearce-Kelly algorithm [1].
+ * A vertex can only reach vertices later in the order thus the search for a path is bounded by the order.
+ *
+ * [1] D. J. Pearce and P. H. J. Kelly, "A dynamic topological sort algorithm for directed acyclic graphs", 2007.
+ */
+class GreedyFuser {
+private:
+    const CostModel &cost_model;
+    const bool avoid_rank0_sweep;
+    const bool sibling;
+    std::vector<Block> blocks;
+    std::vector<std::set<Vertex> > children, parents;
+    std::vector<bool> alive;
+    // The version of a vertex is incremented every time its block changes
+    std::vector<uint64_t> version;
+    // The memory traffic of each vertex, which we keep in order to calculate the weights fast
+    std::vector<BlockTraffic> traffic;
+    // In sibling mode: the non-temporary input arrays of each vertex and the vertices that reads each array
+    std::vector<std::set<bh_base *> > inputs;
+    std::map<bh_base *, std::set<Vertex> > readers;
+    // The position of each vertex in the topological order
+    std::vector<uint64_t> ord;
+    // A vertex is visited by the current search when `visited[v] == visit_stamp`
+    std::vector<uint64_t> visited;
+    uint64_t visit_stamp = 0;
+    std::priority_queue<WeightedEdge> queue;
+
+    // Update `traffic` and `inputs` of vertex `v`
+    void updateBases(Vertex v) {
+        const bool is_loop = alive[v] and not blocks[v].isInstr();
+        traffic[v] = alive[v] ? block_traffic(blocks[v], cost_model.cacheLine()) : BlockTraffic();
+        if (sibling) {
+            for (bh_base *base: inputs[v]) {
+                readers[base].erase(v);
+            }
+            inputs[v].clear();
+            if (is_loop) {
+                const set<bh_base *> temps = blocks[v].getLoop().getAllTemps();
+                for (const InstrPtr &instr: blocks[v].getAllInstr()) {
+                    for (size_t i = 1; i < instr->operand.size(); ++i) {
+                        const bh_view &view = instr->operand[i];
+                        if (not bh_is_constant(&view) and not util::exist(temps, view.base)) {
+                            inputs[v].insert(view.base);
+                            readers[view.base].insert(v);
+                        }
                     }
                 }
             }
         }
-        // Any more vertices to fuse?
-        if (fusibles.size() == 0) {
-            break;
+    }
+
+    // Push the edge 'src' => 'dst' if its blocks are mergeable
+    void pushEdge(Vertex src, Vertex dst) {
+        if (not mergeable(blocks[src], blocks[dst], avoid_rank0_sweep)) {
+            return;
+        }
+        const double benefit = cost_model.benefit(traffic[src], traffic[dst]);
+        if (benefit >= 0) {
+            queue.push({benefit, src, dst, version[src], version[dst]});
         }
+    }
 
-        // Let's find the greatest weight edge.
-        Edge greatest = fusibles.front();
-        uint64_t greatest_weight = weight(dag[source(greatest, dag)], dag[target(greatest, dag)]);
-        for (Edge e: fusibles) {
-            const uint64_t w = weight(dag[source(e, dag)], dag[target(e, dag)]);
-            if (w > greatest_weight) {
-                greatest = e;
-                greatest_weight = w;
+    // Push the pair 'a' and 'b' if their blocks are mergeable and they read the same arrays (sibling mode)
+    void pushSibling(Vertex a, Vertex b) {
+        if (ord[a] > ord[b]) {
+            std::swap(a, b);
+        }
+        if (util::exist(children[a], b) or not mergeable(blocks[a], blocks[b], avoid_rank0_sweep)) {
+            return;
+        }
+        bool shares_input = false;
+        for (bh_base *base: inputs[a]) {
+            if (util::exist(inputs[b], base)) {
+                shares_input = true;
+                break;
+            }
+        }
+        if (shares_input) {
+            const double benefit = cost_model.benefit(traffic[a], traffic[b]);
+            if (benefit > 0) {
+                queue.push({benefit, a, b, version[a], version[b]});
             }
         }
-        Vertex v1 = source(greatest, dag);
-        Vertex v2 = target(greatest, dag);
-//        cout << "merge: " << v1 << ", " << v2 << endl;
+    }
 
-        assert(not path_exist(v1, v2, dag, true)); // Transitive edges should have been removed by now
+    // Push the siblings of 'v', i.e. the vertices that reads one of the inputs of 'v'
+    void pushSiblings(Vertex v) {
+        set<Vertex> siblings;
+        for (bh_base *base: inputs[v]) {
+            const set<Vertex> &vs = readers[base];
+            siblings.insert(vs.begin(), vs.end());
+        }
+        siblings.erase(v);
+        for (Vertex sib: siblings) {
+            pushSibling(v, sib);
+        }
+    }
 
-        merge_vertices(dag, v1, v2, true);
+    // Returns true when a path exist from 'src' to 'dst'
+    // If 'only_long_path' is true, the path must be of length greater than one
+    bool pathExist(Vertex src, Vertex dst, bool only_long_path) {
+        if (ord[dst] < ord[src]) {
+            return false;
+        }
+        ++visit_stamp;
+        vector<Vertex> stack;
+        for (Vertex v: children[src]) {
+            if (v == dst and not only_long_path) {
+                return true;
+            }
+            if (v != dst and ord[v] < ord[dst]) {
+                visited[v] = visit_stamp;
+                stack.push_back(v);
+            }
+        }
+        while (not stack.empty()) {
+            const Vertex v = stack.back();
+            stack.pop_back();
+            for (Vertex child: children[v]) {
+                if (child == dst) {
+                    return true;
+                }
+                if (ord[child] < ord[dst] and visited[child] != visit_stamp) {
+                    visited[child] = visit_stamp;
+                    stack.push_back(child);
+                }
+            }
+        }
+        return false;
     }
-    assert(validate(dag));
+
+    // Reorder the vertices after the insertion of the edge 'src' => 'dst' where `ord[dst] < ord[src]`
+    void reorder(Vertex src, Vertex dst) {
+        const uint64_t lower = ord[dst], upper = ord[src];
+
+        // The vertices reachable from 'dst' that are before 'src' in the order
+        ++visit_stamp;
+        vector<Vertex> forward, stack = {dst};
+        visited[dst] = visit_stamp;
+        while (not stack.empty()) {
+            const Vertex v = stack.back();
+            stack.pop_back();
+            forward.push_back(v);
+            for (Vertex child: children[v]) {
+                assert(child != src); // The edge makes a cycle
+                if (ord[child] < upper and visited[child] != visit_stamp) {
+                    visited[child] = visit_stamp;
+                    stack.push_back(child);
+                }
+            }
+        }
+        // The vertices that reach 'src' that are after 'dst' in the order
+        ++visit_stamp;
+        vector<Vertex> backward;
+        stack = {src};
+        visited[src] = visit_stamp;
+        while (not stack.empty()) {
+            const Vertex v = stack.back();
+            stack.pop_back();
+            backward.push_back(v);
+            for (Vertex parent: parents[v]) {
+                if (ord[parent] > lower and visited[parent] != visit_stamp) {
+                    visited[parent] = visit_stamp;
+                    stack.push_back(parent);
+                }
+            }
+        }
+        // The backward vertices take the first positions and the forward vertices the rest
+        const auto by_ord = [this](Vertex a, Vertex b) { return ord[a] < ord[b]; };
+        sort(forward.begin(), forward.end(), by_ord);
+        sort(backward.begin(), backward.end(), by_ord);
+        vector<uint64_t> positions;
+        positions.reserve(forward.size() + backward.size());
+        for (Vertex v: backward) {
+            positions.push_back(ord[v]);
+        }
+        for (Vertex v: forward) {
+            positions.push_back(ord[v]);
+        }
+        sort(positions.begin(), positions.end());
+        size_t i = 0;
+        for (Vertex v: backward) {
+            ord[v] = positions[i++];
+        }
+        for (Vertex v: forward) {
+            ord[v] = positions[i++];
+        }
+    }
+
+    // Merge vertex 'b' into vertex 'a' where 'a' => 'b' is a non-transitive edge or, in sibling mode,
+    // where no path exist between 'a' and 'b' and 'a' is before 'b' in the order
+    void merge(Vertex a, Vertex b) {
+        assert(not blocks[a].isInstr());
+        assert(not blocks[b].isInstr());
+        blocks[a] = reshape_and_merge(blocks[a].getLoop(), blocks[b].getLoop());
+        assert(blocks[a].validation());
+        ++version[a];
+        updateBases(a);
+
+        // Let's remove 'b' from the graph
+        alive[b] = false;
+        blocks[b] = Block();
+        updateBases(b);
+        children[a].erase(b);
+        parents[b].erase(a);
+        for (Vertex child: children[b]) {
+            parents[child].erase(b);
+        }
+        for (Vertex parent: parents[b]) {
+            children[parent].erase(b);
+        }
+
+        // The children of 'b' are after 'a' in the order already
+        for (Vertex child: children[b]) {
+            children[a].insert(child);
+            parents[child].insert(a);
+        }
+        // Whereas the parents of 'b' might have to be moved before 'a'
+        for (Vertex parent: parents[b]) {
+            if (parents[a].insert(parent).second) {
+                children[parent].insert(a);
+                if (ord[a] < ord[parent]) {
+                    reorder(parent, a);
+                }
+            }
+        }
+        children[b].clear();
+        parents[b].clear();
+
+        // Finally, the edges (or siblings) of 'a' have new weights
+        if (sibling) {
+            pushSiblings(a);
+        } else {
+            for (Vertex child: children[a]) {
+                pushEdge(a, child);
+            }
+            for (Vertex parent: parents[a]) {
+                pushEdge(parent, a);
+            }
+        }
+    }
+
+public:
+    GreedyFuser(const DAG &dag, const CostModel &cost_model, bool avoid_rank0_sweep, bool sibling) :
+            cost_model(cost_model), avoid_rank0_sweep(avoid_rank0_sweep), sibling(sibling) {
+        const size_t num_vertices = boost::num_vertices(dag);
+        blocks.reserve(num_vertices);
+        BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+            blocks.push_back(dag[v]);
+        }
+        children.resize(num_vertices);
+        parents.resize(num_vertices);
+        alive.resize(num_vertices, true);
+        version.resize(num_vertices, 0);
+        traffic.resize(num_vertices);
+        inputs.resize(num_vertices);
+        visited.resize(num_vertices, 0);
+        for (Vertex v = 0; v < num_vertices; ++v) {
+            updateBases(v);
+        }
+        BOOST_FOREACH(Edge e, boost::edges(dag)) {
+            children[source(e, dag)].insert(target(e, dag));
+            parents[target(e, dag)].insert(source(e, dag));
+        }
+        // NB: `topological_sort()` writes the vertices in reverse topological order
+        vector<Vertex> topological_order;
+        boost::topological_sort(dag, back_inserter(topological_order));
+        ord.resize(num_vertices);
+        for (size_t i = 0; i < topological_order.size(); ++i) {
+            ord[topological_order[i]] = num_vertices - 1 - i;
+        }
+        if (sibling) {
+            for (Vertex v = 0; v < num_vertices; ++v) {
+                pushSiblings(v);
+            }
+        } else {
+            BOOST_FOREACH(Edge e, boost::edges(dag)) {
+                pushEdge(source(e, dag), target(e, dag));
+            }
+        }
+    }
+
+    // Merge the greatest weight edge until no fusible edge remains and returns the blocks in topological order
+    vector<Block> run() {
+        while (not queue.empty()) {
+            const WeightedEdge e = queue.top();
+            queue.pop();
+            if (not (alive[e.src] and alive[e.dst]) or version[e.src] != e.src_version or
+                version[e.dst] != e.dst_version) {
+                continue; // Outdated edge
+            }
+            if (sibling) {
+                // The order might have changed since the pair was pushed
+                Vertex a = e.src, b = e.dst;
+                if (ord[a] > ord[b]) {
+                    std::swap(a, b);
+                    if (not mergeable(blocks[a], blocks[b], avoid_rank0_sweep)) {
+                        continue;
+                    }
+                }
+                // NB: since merging never removes a path, dependent siblings stay dependent
+                if (not pathExist(a, b, false)) {
+                    merge(a, b);
+                }
+                continue;
+            }
+            if (not util::exist(children[e.src], e.dst)) {
+                continue; // Removed edge
+            }
+            // Merging over a transitive edge would make a cycle. Since merging never makes a transitive edge
+            // non-transitive, we can remove the edge for good.
+            if (pathExist(e.src, e.dst, true)) {
+                children[e.src].erase(e.dst);
+                parents[e.dst].erase(e.src);
+                continue;
+            }
+            merge(e.src, e.dst);
+        }
+
+        vector<Vertex> order;
+        for (Vertex v = 0; v < blocks.size(); ++v) {
+            if (alive[v]) {
+                order.push_back(v);
+            }
+        }
+        sort(order.begin(), order.end(), [this](Vertex a, Vertex b) { return ord[a] < ord[b]; });
+        vector<Block> ret;
+        ret.reserve(order.size());
+        for (Vertex v: order) {
+            ret.push_back(std::move(blocks[v]));
+        }
+        return ret;
+    }
+};
+}
+
+vector<Block> greedy(const DAG &dag, const CostModel &cost_model, bool avoid_rank0_sweep) {
+    GreedyFuser fuser(dag, cost_model, avoid_rank0_sweep, false);
+    return fuser.run();
+}
+
+vector<Block> sibling(const DAG &dag, const CostModel &cost_model, bool avoid_rank0_sweep) {
+    GreedyFuser fuser(dag, cost_model, avoid_rank0_sweep, true);
+    return fuser.run();
 }
 
 } // graph
@@ -757,6 +757,63 @@ void write_instr(const Scope &scope, const bh_instruction &instr, stringstream &
     }
 }
 
+bool has_simd_operation(bh_opcode opcode) {
+    switch (opcode) {
+        case BH_IDENTITY:
+        case BH_ADD:
+        case BH_SUBTRACT:
+        case BH_MULTIPLY:
+        case BH_DIVIDE:
+        case BH_EXP:
+        case BH_LOG:
+        case BH_SIN:
+        case BH_COS:
+        case BH_TANH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void write_simd_operation(const bh_instruction &instr, const vector<string> &ops, const string &type,
+                          stringstream &out) {
+    switch (instr.opcode) {
+        case BH_IDENTITY:
+            out << ops[1];
+            break;
+        case BH_ADD:
+            out << ops[1] << " + " << ops[2];
+            break;
+        case BH_SUBTRACT:
+            out << ops[1] << " - " << ops[2];
+            break;
+        case BH_MULTIPLY:
+            out << ops[1] << " * " << ops[2];
+            break;
+        case BH_DIVIDE:
+            out << ops[1] << " / " << ops[2];
+            break;
+        case BH_EXP:
+            out << "bh_simd_exp_" << type << "(" << ops[1] << ")";
+            break;
+        case BH_LOG:
+            out << "bh_simd_log_" << type << "(" << ops[1] << ")";
+            break;
+        case BH_SIN:
+            out << "bh_simd_sin_" << type << "(" << ops[1] << ")";
+            break;
+        case BH_COS:
+            out << "bh_simd_cos_" << type << "(" << ops[1] << ")";
+            break;
+        case BH_TANH:
+            out << "bh_simd_tanh_" << type << "(" << ops[1] << ")";
+            break;
+        default:
+            cout << "write_simd_operation: unsupported operation: " << bh_opcode_text(instr.opcode) << endl;
+            throw runtime_error("write_simd_operation: unsupported operation");
+    }
+}
+
 bool has_reduce_identity(bh_opcode opcode) {
     switch (opcode) {
         case BH_ADD_REDUCE:
@@ -0,0 +1,157 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <bh_memory.h>
+#include <jitk/memory_plan.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+MemoryPlan::MemoryPlan(const std::vector<uint64_t> &sizes,
+                       const std::vector<std::vector<size_t> > &accesses,
+                       const std::vector<std::vector<size_t> > &frees) : steps(accesses.size()) {
+    constexpr size_t NONE = numeric_limits<size_t>::max();
+
+    // The live range of each array is from its first access to its free
+    vector<size_t> first_access(sizes.size(), NONE);
+    vector<size_t> free_step(sizes.size(), NONE);
+    for (size_t i = 0; i < accesses.size(); ++i) {
+        for (size_t array: accesses[i]) {
+            first_access[array] = min(first_access[array], i);
+        }
+    }
+    for (size_t i = 0; i < frees.size(); ++i) {
+        for (size_t array: frees[i]) {
+            free_step[array] = i;
+        }
+    }
+
+    // Linear scan over the steps where the arrays of a step get the best fitting buffer among the buffers released
+    // by earlier steps. We hand out the largest arrays first since they leave the most memory unused by a bad fit.
+    // NB: a buffer is only reused by an array of at least half its size thus the plan cannot waste much memory
+    vector<size_t> buffer_of(sizes.size(), NONE);
+    vector<size_t> released;
+    for (size_t i = 0; i < steps.size(); ++i) {
+        vector<size_t> arrays;
+        for (size_t array: accesses[i]) {
+            if (first_access[array] == i and free_step[array] != NONE and free_step[array] >= i and sizes[array] > 0
+                and buffer_of[array] == NONE) {
+                arrays.push_back(array);
+            }
+        }
+        stable_sort(arrays.begin(), arrays.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+        for (size_t array: arrays) {
+            auto best = released.end();
+            for (auto it = released.begin(); it != released.end(); ++it) {
+                const uint64_t capacity = capacities[*it];
+                if (capacity >= sizes[array] and capacity <= 2 * sizes[array] and
+                    (best == released.end() or capacity < capacities[*best])) {
+                    best = it;
+                }
+            }
+            if (best == released.end()) {
+                buffer_of[array] = capacities.size();
+                capacities.push_back(sizes[array]);
+            } else {
+                buffer_of[array] = *best;
+                released.erase(best);
+            }
+            steps[i].push_back({array, buffer_of[array]});
+        }
+        if (i < frees.size()) {
+            for (size_t array: frees[i]) {
+                if (buffer_of[array] != NONE) {
+                    released.push_back(buffer_of[array]);
+                }
+            }
+        }
+    }
+}
+
+MemoryPlan::Execution::~Execution() {
+    for (size_t i = 0; i < _buffers.size(); ++i) {
+        if (_buffers[i] != nullptr) {
+            bh_memory_free(_buffers[i], static_cast<int64_t>(_plan.capacities[i]));
+        }
+    }
+    _stat.mem_plan_unplanned = max(_stat.mem_plan_unplanned, _unplanned);
+    _stat.mem_plan_peak_buffers = max(_stat.mem_plan_peak_buffers, _mapped);
+}
+
+void MemoryPlan::Execution::assign(size_t step, const std::vector<bh_base*> &arrays) {
+    if (step >= _plan.steps.size()) {
+        return;
+    }
+    for (const Assignment &assignment: _plan.steps[step]) {
+        bh_base *base = arrays[assignment.array];
+        // NB: an array that is already allocated keeps its memory, e.g. an array created before the flush
+        if (base->data != nullptr) {
+            continue;
+        }
+        void *&buffer = _buffers[assignment.buffer];
+        if (buffer == nullptr) {
+            buffer = bh_memory_malloc(static_cast<int64_t>(_plan.capacities[assignment.buffer]));
+            if (buffer == nullptr) {
+                stringstream ss;
+                ss << "MemoryPlan::Execution::assign() could not allocate a data region. "
+                   << "Returned error code: " << strerror(errno);
+                throw runtime_error(ss.str());
+            }
+            _mapped += _plan.capacities[assignment.buffer];
+        } else {
+            // The buffer might still belong to an array that wasn't freed through `free()`
+            bool in_use = false;
+            for (const bh_base *other: arrays) {
+                in_use = in_use or other->data == buffer;
+            }
+            if (in_use) {
+                continue;
+            }
+            ++_stat.mem_plan_reuses;
+        }
+        base->data = buffer;
+        ++_stat.mem_plan_arrays;
+        _unplanned += static_cast<uint64_t>(bh_base_size(base));
+    }
+}
+
+void MemoryPlan::Execution::free(bh_base *base) {
+    if (base->data != nullptr) {
+        for (void *buffer: _buffers) {
+            if (buffer == base->data) {
+                base->data = nullptr;
+                return;
+            }
+        }
+    }
+    bh_data_free(base);
+}
+
+} // jitk
+} // bohrium
@@ -0,0 +1,168 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <set>
+#include <unordered_map>
+
+#include <bh_util.hpp>
+#include <bh_memory.h>
+#include <jitk/plan_cache.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+constexpr uint64_t SEP_INSTR = UINT64_MAX;
+constexpr uint64_t SEP_CONSTANT = UINT64_MAX - 1;
+constexpr uint64_t NEW_BASE = UINT64_MAX - 2;
+}
+
+/* The plan key consists of the following fields for each instruction:
+ * <opcode>[<operand>...]<SEP_INSTR>
+ * where each operand is either a constant:
+ *   <SEP_CONSTANT><dtype>
+ * or a view:
+ *   <base_id>[<NEW_BASE><dtype><nelem><is_allocated>]<start><ndim>[<shape><stride>...]
+ * The allocation state is part of the key since it decides the constructor flags and thus the fusion.
+ * Notice, we compare the words rather than a hash of them since a collision would launch kernels on the wrong arrays.
+ */
+vector<uint64_t> PlanCache::key(const BhIR &bhir, std::vector<bh_base*> &bases) {
+    vector<uint64_t> words;
+    words.reserve(bhir.instr_list.size() * 16);
+    unordered_map<const bh_base*, size_t> base_ids;
+    for (const bh_instruction &instr: bhir.instr_list) {
+        words.push_back(static_cast<uint64_t>(instr.opcode));
+        for (const bh_view &view: instr.operand) {
+            if (bh_is_constant(&view)) {
+                words.push_back(SEP_CONSTANT);
+                words.push_back(static_cast<uint64_t>(instr.constant.type));
+                continue;
+            }
+            auto it = base_ids.find(view.base);
+            if (it == base_ids.end()) {
+                it = base_ids.insert(make_pair(view.base, bases.size())).first;
+                bases.push_back(view.base);
+                words.push_back(it->second);
+                words.push_back(NEW_BASE);
+                words.push_back(static_cast<uint64_t>(view.base->type));
+                words.push_back(static_cast<uint64_t>(view.base->nelem));
+                words.push_back(view.base->data != nullptr);
+            } else {
+                words.push_back(it->second);
+            }
+            words.push_back(static_cast<uint64_t>(view.start));
+            words.push_back(static_cast<uint64_t>(view.ndim));
+            for (int64_t i = 0; i < view.ndim; ++i) {
+                words.push_back(static_cast<uint64_t>(view.shape[i]));
+                words.push_back(static_cast<uint64_t>(view.stride[i]));
+            }
+        }
+        words.push_back(SEP_INSTR);
+    }
+    return words;
+}
+
+ExecutionPlan *PlanCache::get(const std::vector<uint64_t> &lookup_key, const BhIR &bhir,
+                              const std::vector<bh_base*> &bases) {
+    ++stat.plan_cache_lookups;
+    auto lookup = _cache.find(lookup_key);
+    if (lookup != _cache.end()) {
+        bool match = true;
+        for (const auto &guard: lookup->second.plan.guards) {
+            if (bhir.instr_list[guard.first].constant != guard.second) {
+                match = false;
+                break;
+            }
+        }
+        for (size_t base_idx: lookup->second.plan.aligned) {
+            const void *data = bases[base_idx]->data;
+            if (data != nullptr and not BH_MEMORY_IS_ALIGNED(data)) {
+                match = false;
+                break;
+            }
+        }
+        if (match) { // Cache hit!
+            _lru.splice(_lru.begin(), _lru, lookup->second.lru);
+            return &lookup->second.plan;
+        }
+    }
+    ++stat.plan_cache_misses;
+    return nullptr;
+}
+
+void PlanCache::insert(const std::vector<uint64_t> &lookup_key, const BhIR &bhir, const std::vector<bh_base*> &bases, ExecutionPlan plan) {
+    map<const bh_base*, size_t> base_ids;
+    for (size_t i = 0; i < bases.size(); ++i) {
+        base_ids.insert(make_pair(bases[i], i));
+    }
+
+    // An array is freed after the last kernel that uses it or before the first kernel if no kernel uses it
+    set<size_t> arguments;
+    for (const bh_instruction &instr: bhir.instr_list) {
+        if (instr.opcode == BH_FREE) {
+            const size_t base_id = base_ids.at(instr.operand[0].base);
+            vector<size_t> *frees = &plan.frees;
+            for (PlanKernel &kernel: plan.kernels) {
+                if (util::exist_linearly(kernel.params, base_id)) {
+                    frees = &kernel.frees;
+                }
+            }
+            frees->push_back(base_id);
+        }
+    }
+
+    // The arrays are planned in the order of the kernels like `EngineCPU` does
+    vector<uint64_t> sizes;
+    for (const bh_base *base: bases) {
+        sizes.push_back(static_cast<uint64_t>(bh_base_size(base)));
+    }
+    vector<vector<size_t> > accesses, kernel_frees;
+    for (const PlanKernel &kernel: plan.kernels) {
+        accesses.push_back(kernel.params);
+        kernel_frees.push_back(kernel.frees);
+    }
+    plan.memory = MemoryPlan(sizes, accesses, kernel_frees);
+
+    // The constants that aren't passed to a kernel are hard-coded thus they must match on a cache hit
+    for (const PlanKernel &kernel: plan.kernels) {
+        arguments.insert(kernel.constants.begin(), kernel.constants.end());
+    }
+    plan.guards.clear();
+    for (size_t i = 0; i < bhir.instr_list.size(); ++i) {
+        const bh_instruction &instr = bhir.instr_list[i];
+        if (instr.has_constant() and not util::exist(arguments, i)) {
+            plan.guards.push_back(make_pair(i, instr.constant));
+        }
+    }
+
+    // A plan whose guards didn't match is replaced
+    erase(lookup_key);
+    if (_max_plans > 0 and _cache.size() >= _max_plans) {
+        _cache.erase(_lru.back());
+        _lru.pop_back();
+    }
+    _lru.push_front(lookup_key);
+    _cache[lookup_key] = Entry{std::move(plan), _lru.begin()};
+}
+
+} // jitk
+} // bohrium
@@ -0,0 +1,174 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <bh_memory.h>
+#include <jitk/thread_pool.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+// The number of times an idle worker checks for a new loop before it sleeps
+constexpr unsigned int SPIN_COUNT = 1u << 14;
+
+// Pin the calling thread to the CPU of kernel thread `tid`, which is the same CPU as the OpenMP thread `tid`
+// when the OpenMP threads are pinned as well (see `bh_memory_numa_thread_cpu()`)
+void pin_thread(unsigned int tid) {
+#ifdef __linux__
+    const int cpu = bh_memory_numa_thread_cpu(tid);
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+#endif
+}
+}
+
+ThreadPool::ThreadPool(unsigned int num_threads, bool pin) {
+    if (num_threads == 0) {
+        num_threads = max(1u, thread::hardware_concurrency());
+    }
+    void *shares = nullptr;
+    if (posix_memalign(&shares, alignof(Share), sizeof(Share) * num_threads) != 0) {
+        throw bad_alloc();
+    }
+    _shares.reset(static_cast<Share*>(shares));
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        new(&_shares[i]) Share();
+    }
+    _num_active.store(num_threads);
+    if (pin) {
+        pin_thread(0);
+    }
+    for (unsigned int i = 1; i < num_threads; ++i) {
+        _workers.emplace_back(&ThreadPool::worker, this, i, pin);
+    }
+}
+
+void ThreadPool::FreeShares::operator()(Share *shares) const {
+    // NB: `Share` is trivially destructible
+    free(shares);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _shutdown = true;
+    }
+    _cond_epoch.notify_all();
+    for (thread &t: _workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::parallelFor(void *pool, LoopBody body, void *args, uint64_t niters) {
+    static_cast<ThreadPool*>(pool)->parallelFor(body, args, niters);
+}
+
+void ThreadPool::setNumThreads(unsigned int num_threads) {
+    _num_active.store(max(1u, min(num_threads, size())), memory_order_relaxed);
+}
+
+void ThreadPool::work(unsigned int tid) {
+    const unsigned int nthds = _num_active.load(memory_order_relaxed);
+    for (unsigned int i = 0; i < nthds; ++i) {
+        Share &share = _shares[(tid + i) % nthds];
+        while (true) {
+            const uint64_t begin = share.next.fetch_add(_chunk, memory_order_relaxed);
+            if (begin >= share.end) {
+                break;
+            }
+            _body(_args, begin, min(begin + _chunk, share.end));
+        }
+    }
+}
+
+void ThreadPool::worker(unsigned int tid, bool pin) {
+    if (pin) {
+        pin_thread(tid);
+    }
+    uint64_t epoch = 0;
+    while (true) {
+        // Let's spin for a while before we go to sleep, which makes consecutive loops cheap
+        unsigned int spin = 0;
+        while (_epoch.load(memory_order_acquire) == epoch and spin < SPIN_COUNT) {
+            ++spin;
+            this_thread::yield();
+        }
+        if (_epoch.load(memory_order_acquire) == epoch) {
+            unique_lock<mutex> lock(_mutex);
+            ++_sleeping;
+            _cond_epoch.wait(lock, [this, epoch] { return _shutdown or _epoch.load() != epoch; });
+            --_sleeping;
+            if (_shutdown) {
+                return;
+            }
+        }
+        epoch = _epoch.load(memory_order_acquire);
+        // NB: the inactive threads aren't part of the barrier
+        if (tid < _num_active.load(memory_order_relaxed)) {
+            work(tid);
+            _pending.fetch_sub(1, memory_order_release);
+        }
+    }
+}
+
+void ThreadPool::parallelFor(LoopBody body, void *args, uint64_t niters) {
+    const unsigned int nthds = _num_active.load(memory_order_relaxed);
+    if (nthds == 1 or niters < 2) {
+        body(args, 0, niters);
+        return;
+    }
+    // The threads start with an even share of the iterations, which they take in chunks of an eighth
+    _body = body;
+    _args = args;
+    for (unsigned int i = 0; i < nthds; ++i) {
+        _shares[i].next.store(niters * i / nthds, memory_order_relaxed);
+        _shares[i].end = niters * (i + 1) / nthds;
+    }
+    _chunk = max(uint64_t{1}, niters / nthds / 8);
+    _pending.store(nthds - 1, memory_order_relaxed);
+    _epoch.fetch_add(1);
+    if (_sleeping.load() > 0) {
+        lock_guard<mutex> lock(_mutex);
+        _cond_epoch.notify_all();
+    }
+    work(0);
+    // The barrier: wait on the workers to finish their chunks
+    while (_pending.load(memory_order_acquire) > 0) {
+        this_thread::yield();
+    }
+}
+
+}} // namespace
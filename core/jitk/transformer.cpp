@@ -18,6 +18,14 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cmath>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <limits>
+#include <unistd.h>
+
+#include <bh_util.hpp>
 #include <jitk/transformer.hpp>
 
 using namespace std;
@@ -136,6 +144,198 @@ bool collapse_loop_with_child(LoopB &loop) {
     }
     return false;
 }
+
+// Help function that returns the stride of the loop with rank 'rank' in the operand 'o' of 'instr',
+// which is zero when the operand doesn't traverse the loop (i.e. the output of a reduction over the loop)
+int64_t loop_stride(const bh_instruction &instr, size_t o, int rank) {
+    int axis = rank;
+    if (o == 0 and bh_opcode_is_reduction(instr.opcode)) {
+        const int sa = instr.sweep_axis();
+        if (sa == rank) {
+            return 0;
+        } else if (sa < rank) {
+            --axis;
+        }
+    }
+    assert(axis < instr.operand[o].ndim);
+    return instr.operand[o].stride[axis];
+}
+
+// Help function that returns the largest power of two that is less or equal to 'n' (and at least one)
+int64_t floor_pow2(uint64_t n) {
+    int64_t ret = 1;
+    while (static_cast<uint64_t>(ret * 2) <= n) {
+        ret *= 2;
+    }
+    return ret;
+}
+
+// Help function that returns the size of the per-core cache of the host, which the tiles should fit in
+uint64_t host_cache_size() {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    const long ret = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (ret > 0) {
+        return static_cast<uint64_t>(ret);
+    }
+#endif
+    return 256 * 1024;
+}
+
+// Help function that returns the number of elements that a row of 'view' spans (beyond the first element)
+int64_t row_span(const bh_view &view) {
+    int64_t ret = 0;
+    for (int64_t d = 1; d < view.ndim; ++d) {
+        ret += std::abs((view.shape[d] - 1) * view.stride[d]);
+    }
+    return ret;
+}
+
+// Help function that tiles the two innermost of the perfectly nested loops of 'block' (if it pays off)
+void tile_loop_nest(LoopB &block, uint64_t tile_size, uint64_t cache_size) {
+    // The loops over the tiles go around 'block' thus the tiled loops must be perfectly nested
+    vector<LoopB*> nest{&block};
+    while (nest.back()->_block_list.size() == 1 and not nest.back()->_block_list[0].isInstr()) {
+        nest.push_back(&nest.back()->_block_list[0].getLoop());
+    }
+    if (nest.size() < 2 or block.isSystemOnly()) {
+        return;
+    }
+    LoopB &outer = *nest[nest.size()-2];
+    LoopB &inner = *nest[nest.size()-1];
+
+    // The tiled loops cannot be sweeped and the sweeps around them must write arrays since
+    // they are computed a tile at a time
+    if (not inner._sweeps.empty()) {
+        return;
+    }
+    const set<bh_base*> temps = block.getAllTemps();
+    for (size_t i = 0; i+1 < nest.size(); ++i) {
+        for (const InstrPtr &instr: nest[i]->_sweeps) {
+            if (util::exist(temps, instr->operand[0].base)) {
+                return;
+            }
+        }
+    }
+
+    // Let's find out whether the loop nest accesses columns, which walks through a cache line per element,
+    // and whether the iterations of the outer loop reuse the row of the previous iterations
+    // (e.g. the output of a reduction over the outer loop or the rows of a stencil)
+    uint64_t num_views = 0;
+    int64_t elem_size = 1;
+    bool column = false, reuse = false;
+    map<const bh_base*, vector<const bh_view*> > views;
+    for (const InstrPtr &instr: block.getAllInstr()) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        if (instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+            return; // The index arrays doesn't map the loops to the views
+        }
+        for (size_t o = 0; o < instr->operand.size(); ++o) {
+            const bh_view &view = instr->operand[o];
+            if (bh_is_constant(&view)) {
+                continue;
+            }
+            const int64_t s_outer = std::abs(loop_stride(*instr, o, outer.rank));
+            const int64_t s_inner = std::abs(loop_stride(*instr, o, inner.rank));
+            column = column or (s_inner > 1 and s_inner > s_outer);
+            reuse = reuse or s_outer == 0;
+            for (const bh_view *v: views[view.base]) {
+                if (s_outer > 0 and std::abs(v->start - view.start) >= s_outer) {
+                    reuse = true;
+                }
+            }
+            views[view.base].push_back(&view);
+            elem_size = std::max(elem_size, static_cast<int64_t>(bh_type_size(view.base->type)));
+            ++num_views;
+        }
+    }
+    if (num_views == 0) {
+        return;
+    }
+
+    // Columns calls for square tiles of both loops whereas the reuse of rows only calls for tiling the inner loop.
+    // Either way, the tiles must be small enough for the arrays to fit in the (half of the) cache.
+    const uint64_t bytes_per_row = num_views * inner.size * elem_size;
+    if (column and outer._sweeps.empty() and bytes_per_row * outer.size > cache_size) {
+        const int64_t t = tile_size > 0 ? tile_size : std::max(int64_t{8}, static_cast<int64_t>(
+                floor_pow2(static_cast<uint64_t>(std::sqrt(cache_size / 2 / (num_views * elem_size))))));
+        if (outer.size > t) {
+            outer.tile = t;
+        }
+        if (inner.size > t) {
+            inner.tile = t;
+        }
+    } else if (reuse and bytes_per_row > cache_size / 2) {
+        const int64_t t = tile_size > 0 ? tile_size : std::max(int64_t{64},
+                                                               floor_pow2(cache_size / 2 / (num_views * elem_size)));
+        if (inner.size > t) {
+            inner.tile = t;
+        }
+    }
+}
+
+// Help function that returns the number of bytes the views in 'instr_list' skip per iteration of the loop
+// with rank 'rank' in total
+uint64_t total_loop_stride(const vector<InstrPtr> &instr_list, int rank) {
+    uint64_t ret = 0;
+    for (const InstrPtr &instr: instr_list) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        for (size_t o = 0; o < instr->operand.size(); ++o) {
+            const bh_view &view = instr->operand[o];
+            if (not bh_is_constant(&view)) {
+                ret += std::abs(loop_stride(*instr, o, rank)) * bh_type_size(view.base->type);
+            }
+        }
+    }
+    return ret;
+}
+
+// Help function that interchanges the perfectly nested loops of 'block' such that the innermost loop is
+// the loop with the smallest total stride (see `total_loop_stride()`). The loops between that loop and
+// the innermost loop move one rank outwards thus they cannot be sweeped.
+void push_unit_stride_inwards(LoopB &block) {
+    vector<LoopB*> nest{&block};
+    while (nest.back()->_block_list.size() == 1 and not nest.back()->_block_list[0].isInstr()) {
+        nest.push_back(&nest.back()->_block_list[0].getLoop());
+    }
+    if (nest.size() < 2 or not nest.back()->isInnermost() or block.isSystemOnly()) {
+        return;
+    }
+    const vector<InstrPtr> instr_list = block.getAllInstr();
+    for (const InstrPtr &instr: instr_list) {
+        if (instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER
+            or instr->ndim() < static_cast<int64_t>(nest.size())) {
+            return;
+        }
+    }
+
+    // Let's find the loop with the smallest total stride, which must beat the innermost loop
+    const int innermost = nest.back()->rank;
+    int best = innermost;
+    uint64_t best_stride = total_loop_stride(instr_list, innermost);
+    for (int rank = innermost-1; rank >= block.rank and nest[rank+1 - block.rank]->_sweeps.empty(); --rank) {
+        const uint64_t stride = total_loop_stride(instr_list, rank);
+        if (stride < best_stride) {
+            best = rank;
+            best_stride = stride;
+        }
+    }
+
+    // Then we swap it inwards one rank at a time
+    for (int rank = best; rank < innermost; ++rank) {
+        LoopB &parent = *nest[rank - block.rank];
+        vector<Block> swapped = swap_blocks(parent, &parent._block_list[0].getLoop());
+        assert(swapped.size() == 1);
+        parent = std::move(swapped[0].getLoop());
+        // NB: the swap rebuilds the loops within 'parent'
+        for (size_t i = rank - block.rank + 1; i < nest.size(); ++i) {
+            nest[i] = &nest[i-1]->_block_list[0].getLoop();
+        }
+    }
+}
 }
 
 void push_reductions_inwards(vector<Block> &block_list) {
@@ -158,6 +358,14 @@ void push_reductions_inwards(vector<Block> &block_list) {
     block_list = ret;
 }
 
+void push_unit_strides_inwards(vector<Block> &block_list) {
+    for (Block &block: block_list) {
+        if (not block.isInstr()) {
+            push_unit_stride_inwards(block.getLoop());
+        }
+    }
+}
+
 void split_for_threading(vector<Block> &block_list, uint64_t min_threading) {
     vector<Block> ret;
 
@@ -238,6 +446,387 @@ void collapse_redundant_axes(vector<Block> &block_list) {
     }
     block_list = ret;
 }
+
+void tile(vector<Block> &block_list, uint64_t tile_size, uint64_t cache_size) {
+    if (cache_size == 0) {
+        cache_size = host_cache_size();
+    }
+    for (Block &block: block_list) {
+        if (not block.isInstr()) {
+            tile_loop_nest(block.getLoop(), tile_size, cache_size);
+        }
+    }
+}
+
+StripMine strip_mine(const vector<Block> &block_list, const vector<bh_base*> &kernel_temps, uint64_t cache_size) {
+    StripMine ret;
+    if (block_list.size() < 2 or kernel_temps.empty()) {
+        return ret;
+    }
+    if (cache_size == 0) {
+        cache_size = host_cache_size();
+    }
+
+    // An array access of a block
+    struct Access {
+        size_t block;
+        const bh_view *view;
+        bool write;
+    };
+
+    // The blocks must be parallel loops that access all arrays through the rows of the outermost loop
+    // (thus the chunks of rows are independent)
+    int64_t size = 0;
+    map<const bh_base*, vector<Access> > accesses;
+    for (size_t i = 0; i < block_list.size(); ++i) {
+        if (block_list[i].isInstr()) {
+            return ret;
+        }
+        const LoopB &loop = block_list[i].getLoop();
+        if (loop.isSystemOnly()) {
+            continue;
+        }
+        if (loop.rank != 0 or not loop._sweeps.empty() or not get_tiled_loops(loop).empty()) {
+            return ret;
+        }
+        size = std::max(size, loop.size);
+        for (const InstrPtr &instr: loop.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode)) {
+                continue;
+            }
+            // These opcodes use the global index or access their arrays at arbitrary indexes
+            if (instr->opcode == BH_RANGE or instr->opcode == BH_RANDOM or instr->opcode == BH_GATHER or
+                instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+                return ret;
+            }
+            for (size_t o = 0; o < instr->operand.size(); ++o) {
+                const bh_view &view = instr->operand[o];
+                if (bh_is_constant(&view)) {
+                    continue;
+                }
+                if (view.ndim < 1 or view.shape[0] != loop.size) {
+                    return ret;
+                }
+                accesses[view.base].push_back({i, &view, o == 0});
+            }
+        }
+    }
+    if (size < 2) {
+        return ret;
+    }
+
+    // The arrays that the blocks communicate through must be accessed a row at a time,
+    // which requires views with the same rows that don't overlap
+    const set<const bh_base*> temps(kernel_temps.begin(), kernel_temps.end());
+    set<const bh_base*> written; // The written arrays that aren't kernel temporaries
+    uint64_t row_bytes = 0;
+    for (const auto &base_accesses: accesses) {
+        const bh_view &first = *base_accesses.second[0].view;
+        row_bytes += std::abs(first.stride[0]) * bh_type_size(base_accesses.first->type);
+        if (util::exist(temps, base_accesses.first)) {
+            continue;
+        }
+        set<size_t> blocks;
+        for (const Access &access: base_accesses.second) {
+            blocks.insert(access.block);
+            if (access.write) {
+                written.insert(base_accesses.first);
+            }
+        }
+        if (util::exist(written, base_accesses.first) and blocks.size() > 1) {
+            for (const Access &access: base_accesses.second) {
+                const bh_view &view = *access.view;
+                if (view.start != first.start or view.stride[0] != first.stride[0] or
+                    row_span(view) >= std::abs(first.stride[0])) {
+                    return ret;
+                }
+            }
+        }
+    }
+
+    // The kernel temporaries become windows of rows thus their rows must make up the whole array and a single
+    // block must write them, which the later blocks may read at any row
+    struct Temp {
+        size_t writer;     // The block that writes the temporary
+        int64_t row;       // The row that the writer accesses at the first iteration
+        int64_t row_elems; // The number of elements in a row
+    };
+    map<const bh_base*, Temp> temp_rows;
+    for (const bh_base *base: kernel_temps) {
+        const vector<Access> &temp_accesses = accesses[base];
+        if (temp_accesses.empty()) {
+            return ret;
+        }
+        const int64_t row_elems = temp_accesses[0].view->stride[0];
+        if (row_elems <= 0 or base->nelem % row_elems != 0) {
+            return ret;
+        }
+        set<size_t> writers;
+        for (const Access &access: temp_accesses) {
+            const bh_view &view = *access.view;
+            if (view.stride[0] != row_elems or view.start % row_elems + row_span(view) >= row_elems) {
+                return ret;
+            }
+            for (int64_t d = 1; d < view.ndim; ++d) {
+                if (view.stride[d] < 0) {
+                    return ret;
+                }
+            }
+            if (access.write) {
+                writers.insert(access.block);
+            }
+        }
+        if (writers.size() != 1) {
+            return ret;
+        }
+        Temp temp{*writers.begin(), -1, row_elems};
+        for (const Access &access: temp_accesses) {
+            const int64_t row = access.view->start / row_elems;
+            if (access.block < temp.writer) {
+                return ret;
+            } else if (access.block == temp.writer) {
+                if (temp.row >= 0 and temp.row != row) {
+                    return ret;
+                }
+                temp.row = row;
+            }
+        }
+        temp_rows.insert(make_pair(base, temp));
+    }
+
+    // The writer of a temporary must execute the rows that the later blocks read, which we find from the last block
+    // to the first. The blocks that write other arrays than temporaries must execute exactly the rows of the chunk.
+    ret.extents.resize(block_list.size(), make_pair(int64_t{0}, int64_t{0}));
+    vector<bool> has_extent(block_list.size(), true);
+    for (const auto &temp: temp_rows) {
+        has_extent[temp.second.writer] = false;
+    }
+    for (const auto &base_accesses: accesses) {
+        for (const Access &access: base_accesses.second) {
+            if (access.write and util::exist(written, base_accesses.first)) {
+                has_extent[access.block] = true;
+            }
+        }
+    }
+    for (size_t i = block_list.size(); i-- > 0;) {
+        for (const auto &temp: temp_rows) {
+            if (temp.second.writer == i) {
+                continue;
+            }
+            for (const Access &access: accesses[temp.first]) {
+                if (access.block != i) {
+                    continue;
+                }
+                const int64_t row = access.view->start / temp.second.row_elems - temp.second.row;
+                pair<int64_t, int64_t> &extent = ret.extents[temp.second.writer];
+                if (has_extent[temp.second.writer]) {
+                    extent.first = std::min(extent.first, ret.extents[i].first + row);
+                    extent.second = std::max(extent.second, ret.extents[i].second + row);
+                } else {
+                    extent = make_pair(ret.extents[i].first + row, ret.extents[i].second + row);
+                    has_extent[temp.second.writer] = true;
+                }
+            }
+        }
+    }
+
+    // The blocks that execute rows of the neighbouring chunks must not write other arrays than temporaries
+    // nor read arrays that the kernel writes
+    int64_t widest = 0;
+    for (const auto &base_accesses: accesses) {
+        for (const Access &access: base_accesses.second) {
+            const pair<int64_t, int64_t> &extent = ret.extents[access.block];
+            if (extent != make_pair(int64_t{0}, int64_t{0}) and util::exist(written, base_accesses.first)) {
+                return ret;
+            }
+            widest = std::max(widest, extent.second - extent.first);
+        }
+    }
+
+    // The chunks of all the arrays must fit in (the half of) the cache, which only pays off when the arrays don't
+    // fit already. The neighbouring chunks execute the rows around a chunk again, which must be a minor part.
+    int64_t rows = std::max(int64_t{1}, static_cast<int64_t>(cache_size / 2 / std::max(uint64_t{1}, row_bytes)));
+    rows = std::max(rows, 4 * widest);
+    if (rows >= size) {
+        return ret;
+    }
+    for (const bh_base *base: kernel_temps) {
+        const Temp &temp = temp_rows.at(base);
+        const pair<int64_t, int64_t> &extent = ret.extents[temp.writer];
+        ret.windows.push_back({extent.first + temp.row, rows + extent.second - extent.first, temp.row_elems});
+    }
+    ret.size = size;
+    ret.rows = rows;
+    return ret;
+}
+
+StripMine time_tile(const vector<Block> &block_list, const vector<bh_base*> &kernel_temps, int64_t steps,
+                    uint64_t cache_size) {
+    StripMine ret;
+    if (steps < 2) {
+        return ret;
+    }
+    if (cache_size == 0) {
+        cache_size = host_cache_size();
+    }
+
+    // An array access of a block, which accesses the rows of the array from `row` onwards
+    struct Access {
+        size_t block;
+        const bh_view *view;
+        bool write;
+        int64_t row;
+    };
+
+    // The blocks must be parallel loops that access the arrays through the rows of the outermost loop
+    int64_t size = 0;
+    vector<size_t> blocks; // The blocks that compute
+    map<const bh_base*, vector<Access> > accesses;
+    for (size_t i = 0; i < block_list.size(); ++i) {
+        if (block_list[i].isInstr()) {
+            return ret;
+        }
+        const LoopB &loop = block_list[i].getLoop();
+        if (loop.isSystemOnly()) {
+            continue;
+        }
+        if (loop.rank != 0 or not loop._sweeps.empty() or not get_tiled_loops(loop).empty()) {
+            return ret;
+        }
+        blocks.push_back(i);
+        size = std::max(size, loop.size);
+        for (const InstrPtr &instr: loop.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode)) {
+                continue;
+            }
+            // These opcodes use the global index or access their arrays at arbitrary indexes
+            if (instr->opcode == BH_RANGE or instr->opcode == BH_RANDOM or instr->opcode == BH_GATHER or
+                instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+                return ret;
+            }
+            for (size_t o = 0; o < instr->operand.size(); ++o) {
+                const bh_view &view = instr->operand[o];
+                if (not bh_is_constant(&view)) {
+                    if (view.ndim < 1 or view.shape[0] != loop.size) {
+                        return ret;
+                    }
+                    accesses[view.base].push_back({i, &view, o == 0, 0});
+                }
+            }
+        }
+    }
+    if (size < 2) {
+        return ret;
+    }
+
+    // The written arrays must be accessed a row at a time, which requires views with the same rows that don't
+    // overlap. A block must access the arrays it writes at a single row since its iterations are independent.
+    uint64_t row_bytes = 0;
+    for (auto &base_accesses: accesses) {
+        vector<Access> &base_access = base_accesses.second;
+        const int64_t stride = base_access[0].view->stride[0];
+        row_bytes += std::abs(stride) * bh_type_size(base_accesses.first->type);
+        set<size_t> writers;
+        for (const Access &access: base_access) {
+            if (access.write) {
+                writers.insert(access.block);
+            }
+        }
+        if (writers.empty()) {
+            continue;
+        }
+        for (Access &access: base_access) {
+            const bh_view &view = *access.view;
+            if (stride <= 0 or view.stride[0] != stride or view.start % stride + row_span(view) >= stride) {
+                return ret;
+            }
+            for (int64_t d = 1; d < view.ndim; ++d) {
+                if (view.stride[d] < 0) {
+                    return ret;
+                }
+            }
+            access.row = view.start / stride;
+        }
+        for (const Access &access: base_access) {
+            for (const Access &other: base_access) {
+                if (access.block == other.block and util::exist(writers, access.block) and access.row != other.row) {
+                    return ret;
+                }
+            }
+        }
+    }
+
+    // The steps of the blocks are the operations that a chunk executes in order. An operation must execute a row in
+    // the same or a later chunk than the earlier operations that access the same element when one of them writes it,
+    // which we ensure by skewing the rows of the operation by its row distance to the earlier operations.
+    const size_t num_ops = steps * blocks.size();
+    vector<int64_t> skew(num_ops, 0);
+    for (size_t q = 0; q < num_ops; ++q) {
+        for (size_t p = 0; p < q; ++p) {
+            for (const auto &base_accesses: accesses) {
+                bool written = false;
+                for (const Access &access: base_accesses.second) {
+                    written = written or access.write;
+                }
+                if (not written) {
+                    continue;
+                }
+                for (const Access &a: base_accesses.second) {
+                    if (a.block != blocks[q % blocks.size()]) {
+                        continue;
+                    }
+                    for (const Access &b: base_accesses.second) {
+                        if (b.block == blocks[p % blocks.size()] and (a.write or b.write)) {
+                            skew[q] = std::max(skew[q], skew[p] + a.row - b.row);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The rows of a chunk and the skewed rows of its operations must fit in (the half of) the cache, which only pays
+    // off when the arrays don't fit already. The skewed rows must be a minor part of the chunk.
+    const int64_t max_skew = *std::max_element(skew.begin(), skew.end());
+    const int64_t rows = static_cast<int64_t>(cache_size / 2 / std::max(uint64_t{1}, row_bytes)) - max_skew;
+    if (rows < std::max(int64_t{1}, max_skew) or rows >= size) {
+        return ret;
+    }
+    ret.extents.resize(steps * block_list.size(), make_pair(int64_t{0}, int64_t{0}));
+    for (size_t o = 0; o < num_ops; ++o) {
+        ret.extents[(o / blocks.size()) * block_list.size() + blocks[o % blocks.size()]] = make_pair(-skew[o],
+                                                                                                      -skew[o]);
+    }
+
+    // The window of a kernel temporary holds the skewed rows that the operations of a chunk access. An operation
+    // may read rows that an earlier operation wrote in an earlier chunk, which are the rows that the window of the
+    // earlier chunk ends with (the window minus the rows of a chunk). The temporaries stay whole arrays when one
+    // of them doesn't consist of whole rows.
+    for (const bh_base *base: kernel_temps) {
+        const vector<Access> &temp_accesses = accesses[base];
+        const int64_t row_elems = temp_accesses.empty() ? 0 : temp_accesses[0].view->stride[0];
+        if (row_elems <= 0 or base->nelem % row_elems != 0) {
+            ret.windows.clear();
+            break;
+        }
+        int64_t first = std::numeric_limits<int64_t>::max();
+        int64_t last = std::numeric_limits<int64_t>::min();
+        for (size_t o = 0; o < num_ops; ++o) {
+            for (const Access &access: temp_accesses) {
+                if (access.block == blocks[o % blocks.size()]) {
+                    first = std::min(first, access.row - skew[o]);
+                    last = std::max(last, access.row - skew[o]);
+                }
+            }
+        }
+        ret.windows.push_back({first, rows + last - first, row_elems});
+    }
+    ret.steps = steps;
+    ret.size = size + max_skew;
+    ret.rows = rows;
+    return ret;
+}
+
 } // jitk
 } // bohrium
 
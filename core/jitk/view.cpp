@@ -28,8 +28,54 @@ using namespace std;
 namespace bohrium {
 namespace jitk {
 
+namespace {
+// Returns true when the index of 'view' can use the offsets declared in 'scope'.
+// NB: the offsets are declared for the regular axes thus hidden and offset axes must calculate the full index
+bool use_declared_offset(const Scope &scope, const bh_view &view, int hidden_axis, const pair<int, int> axis_offset) {
+    return hidden_axis == BH_MAXDIM and axis_offset.first == BH_MAXDIM and not bh_is_scalar(&view) and
+           scope.getOffsetRank(view) >= 0;
+}
+}
+
+void write_array_offset(const Scope &scope, const bh_view &view, int last_axis, stringstream &out) {
+    const bool strides_as_var = scope.symbols.strides_as_var and scope.symbols.existOffsetStridesID(view);
+    bool empty_subscription = true;
+    int first_axis = 0;
+    const int declared_rank = scope.getOffsetRank(view);
+    if (declared_rank >= 0) {
+        assert(declared_rank <= last_axis);
+        scope.getOffsetName(view, declared_rank, out);
+        first_axis = declared_rank + 1;
+        empty_subscription = false;
+    } else if (strides_as_var) {
+        out << "vo" << scope.symbols.offsetStridesID(view);
+        empty_subscription = false;
+    } else if (view.start > 0) {
+        out << view.start;
+        empty_subscription = false;
+    }
+    for (int i = first_axis; i <= last_axis; ++i) {
+        if (strides_as_var) {
+            out << " +i" << i << "*vs" << scope.symbols.offsetStridesID(view) << "_" << i;
+            empty_subscription = false;
+        } else if (view.stride[i] != 0) {
+            out << " +i" << i;
+            if (view.stride[i] != 1) {
+                out << "*" << view.stride[i];
+            }
+            empty_subscription = false;
+        }
+    }
+    if (empty_subscription)
+        out << "0";
+}
+
 void write_array_index(const Scope &scope, const bh_view &view, stringstream &out,
                        int hidden_axis, const pair<int, int> axis_offset) {
+    if (use_declared_offset(scope, view, hidden_axis, axis_offset)) {
+        write_array_offset(scope, view, static_cast<int>(view.ndim) - 1, out);
+        return;
+    }
     bool empty_subscription = true;
     if (view.start > 0) {
         out << view.start;
@@ -59,6 +105,10 @@ void write_array_index(const Scope &scope, const bh_view &view, stringstream &ou
 
 void write_array_index_variables(const Scope &scope, const bh_view &view, stringstream &out,
                                  int hidden_axis, const pair<int, int> axis_offset) {
+    if (use_declared_offset(scope, view, hidden_axis, axis_offset)) {
+        write_array_offset(scope, view, static_cast<int>(view.ndim) - 1, out);
+        return;
+    }
 
     // Write view.start using the offset-and-strides variable
     out << "vo" << scope.symbols.offsetStridesID(view);
@@ -241,6 +241,14 @@ class ConfigParser {
      */
     std::string getChildLibraryPath() const;
 
+    /* Returns a hash of the options (incl. environment overrides) in the default section.
+     * Use it to tag data that is only valid for the current configuration.
+     *
+     * @ignore  Options that should not affect the hash
+     * @return  The hash
+     */
+    uint64_t hashOfSection(const std::vector<std::string> &ignore = {}) const;
+
     /* Retrieve the name of the calling component
      *
      * @return Component name as given in the config file
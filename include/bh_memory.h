@@ -25,6 +25,11 @@ If not, see <http://www.gnu.org/licenses/>.
 extern "C" {
 #endif
 
+/* The alignment (in bytes) of the memory returned by bh_memory_malloc(),
+ * which the kernels may assume for arrays it allocates */
+#define BH_MEMORY_ALIGNMENT 64
+#define BH_MEMORY_IS_ALIGNED(ptr) (((uintptr_t)(ptr)) % BH_MEMORY_ALIGNMENT == 0)
+
 /* Allocate an alligned contigous block of memory,
  * without any initialization
  *
@@ -41,6 +46,89 @@ void* bh_memory_malloc(int64_t size);
  */
 int64_t bh_memory_free(void* data, int64_t size);
 
+/* Statistics of the pool that bh_memory_malloc() reuses freed memory from */
+typedef struct {
+    uint64_t hits;          // Allocations served by the pool
+    uint64_t misses;        // Allocations that mapped new memory
+    uint64_t retained;      // Bytes currently retained by the pool
+    uint64_t max_retained;  // The peak of `retained`
+    uint64_t spilled;       // Bytes currently backed by files in the spill directory
+    uint64_t max_spilled;   // The peak of `spilled`
+} bh_memory_pool_stat;
+
+/* Configure the memory pool of bh_memory_malloc() and bh_memory_free()
+ *
+ * @max_retained        The maximum number of bytes of freed memory to retain for reuse (0 disables the pool)
+ * @hugepage_threshold  Blocks of this size or larger are advised to use huge pages (0 disables)
+ */
+void bh_memory_pool_config(uint64_t max_retained, uint64_t hugepage_threshold);
+
+/* Returns the statistics of the memory pool
+ *
+ * @return The statistics
+ */
+bh_memory_pool_stat bh_memory_pool_stats(void);
+
+/* The NUMA placement of the memory that bh_memory_malloc() maps */
+typedef enum {
+    BH_NUMA_NONE,        // The OS places each page where it is touched first
+    BH_NUMA_INTERLEAVE,  // The pages are interleaved round-robin across the NUMA nodes
+    BH_NUMA_FIRST_TOUCH  // The pages are placed where the static schedule of the kernel threads touches them
+} bh_numa_policy;
+
+/* Configure the NUMA placement of bh_memory_malloc()
+ * NB: kernel thread `i` is expected to run on the CPU returned by bh_memory_numa_thread_cpu(i)
+ *
+ * @policy       The placement policy, which has no effect on machines with a single NUMA node
+ * @num_threads  The number of kernel threads that the static schedule of BH_NUMA_FIRST_TOUCH divides an array among
+ */
+void bh_memory_numa_config(bh_numa_policy policy, uint64_t num_threads);
+
+/* Returns the CPU that kernel thread `thread_id` should be pinned to, which is the
+ * `thread_id`'th CPU (modulo the number of CPUs) that the process may run on
+ *
+ * @thread_id  The ID of the kernel thread
+ * @return     The CPU or -1 if unknown
+ */
+int bh_memory_numa_thread_cpu(uint64_t thread_id);
+
+/* Samples the NUMA placement of the pages of a block returned by bh_memory_malloc(). A sampled page is remote
+ * when it is on another NUMA node than the kernel thread that handles it in a static schedule.
+ * NB: nothing is sampled on machines with a single NUMA node or when the OS doesn't support it
+ *
+ * @data         The pointer returned from a call to bh_memory_malloc
+ * @num_threads  The number of kernel threads of the static schedule
+ * @sampled      Incremented by the number of sampled pages
+ * @remote       Incremented by the number of sampled pages that are remote
+ */
+void bh_memory_numa_sample(const void *data, uint64_t num_threads, uint64_t *sampled, uint64_t *remote);
+
+/* Configure the file-backed blocks of bh_memory_malloc(), which makes it possible to allocate arrays larger than
+ * RAM. The memory of a file-backed block is written to an unlinked file in `spill_dir` under memory pressure.
+ *
+ * @spill_dir  The directory of the files (NULL or empty disables file-backed blocks)
+ * @threshold  Blocks of this size or larger are file-backed (0 means only when anonymous memory runs out)
+ */
+void bh_memory_spill_config(const char *spill_dir, uint64_t threshold);
+
+/* Hint that a range of a block returned by bh_memory_malloc() will be accessed soon,
+ * which makes the OS read the range of a file-backed block ahead
+ *
+ * @data    The pointer returned from a call to bh_memory_malloc
+ * @offset  The offset of the range in bytes
+ * @nbytes  The size of the range in bytes
+ */
+void bh_memory_spill_prefetch(const void *data, uint64_t offset, uint64_t nbytes);
+
+/* Write a range of a file-backed block returned by bh_memory_malloc() back to its file and
+ * release its memory. Blocks that aren't file-backed are ignored.
+ *
+ * @data    The pointer returned from a call to bh_memory_malloc
+ * @offset  The offset of the range in bytes
+ * @nbytes  The size of the range in bytes
+ */
+void bh_memory_spill_evict(const void *data, uint64_t offset, uint64_t nbytes);
+
 #ifdef __cplusplus
 }
 #endif
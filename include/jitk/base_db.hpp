@@ -26,6 +26,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <bh_view.hpp>
 #include <bh_util.hpp>
+#include <bh_memory.h>
 
 #include <jitk/block.hpp>
 
@@ -79,6 +80,31 @@ struct Constant_less {
     }
 };
 
+// The strip-mining of a kernel, which executes all of its blocks on a chunk of rows of the outermost loops at a time
+// (see `strip_mine()` and `time_tile()`)
+struct StripMine {
+    // The part of a kernel temporary that a chunk needs, which is all the chunk holds of the temporary
+    struct Window {
+        int64_t offset;    // The first row relative to the first row of the chunk
+        int64_t rows;      // The number of rows
+        int64_t row_elems; // The number of elements in a row
+    };
+    // The number of rows in a chunk (zero means the kernel isn't strip-mined)
+    int64_t rows = 0;
+    // The number of rows that the chunks cover, which is the size of the largest outermost loop (and the skew)
+    int64_t size = 0;
+    // The number of times a chunk executes the blocks. The chunks of a time-tiled kernel, which executes several
+    // (time) steps, depend on the earlier chunks thus execute in order.
+    int64_t steps = 1;
+    // The rows each block of each step executes relative to the first and the last row of the chunk. Blocks that
+    // write a kernel temporary, which a later block reads at neighbouring rows (e.g. a stencil), execute the rows
+    // around the chunk too. The steps of a time-tiled kernel execute skewed rows.
+    std::vector<std::pair<int64_t, int64_t> > extents;
+    // The window of each kernel temporary (empty when the kernel temporaries are whole arrays). The window of a
+    // time-tiled kernel starts with the rows that the previous chunk ends with, which the chunk reads.
+    std::vector<Window> windows;
+};
+
 // The SymbolTable class contains all array meta date needed for a JIT kernel.
 class SymbolTable {
 private:
@@ -92,6 +118,7 @@ private:
     std::vector<bh_base*> _params; // Vector of non-temporary arrays, which are the in-/out-puts of the JIT kernel
     std::set<bh_base*> _frees; // Set of freed arrays
     bool _useRandom; // Flag: is any instructions using random?
+    bool _assumeAligned; // Flag: are all non-temporary arrays aligned to `BH_MEMORY_ALIGNMENT`?
 
 public:
     // Should we declare scalar variables using the volatile keyword?
@@ -102,18 +129,32 @@ public:
     const bool index_as_var;
     // Should we use constants as variables?
     const bool const_as_var;
+    // Should we use the loop sizes (and the size of kernel temporaries) as variables?
+    const bool shape_as_var;
+    // Should we save the part of the index calculations that is invariant to the inner loops in variables?
+    const bool offsets_as_var;
+    // The strip-mining of the kernel (see `strip_mine()`)
+    const StripMine strip;
 
     SymbolTable(const std::vector<InstrPtr> &instr_list,
                 const std::set<bh_base *> &non_temp_arrays,
                 bool use_volatile,
                 bool strides_as_var,
                 bool index_as_var,
-                bool const_as_var) :
+                bool const_as_var,
+                bool shape_as_var = false,
+                bool offsets_as_var = false,
+                bool assume_aligned = false,
+                StripMine strip = StripMine()) :
         _useRandom(false),
+        _assumeAligned(assume_aligned),
         use_volatile(use_volatile),
         strides_as_var(strides_as_var),
         index_as_var(index_as_var),
-        const_as_var(const_as_var) {
+        const_as_var(const_as_var),
+        shape_as_var(shape_as_var),
+        offsets_as_var(offsets_as_var),
+        strip(std::move(strip)) {
         // NB: by assigning the IDs in the order they appear in the 'instr_list',
         //     the kernels can better be reused
         for (const InstrPtr &instr: instr_list) {
@@ -152,6 +193,12 @@ public:
                 }
             }
         }
+        // NB: arrays that aren't allocated yet will be allocated by `bh_memory_malloc()`, which aligns them
+        for (const bh_base *base: _params) {
+            if (base->data != nullptr and not BH_MEMORY_IS_ALIGNED(base->data)) {
+                _assumeAligned = false;
+            }
+        }
         if (strides_as_var) {
             _offset_stride_views.resize(_offset_strides_map.size());
             for(auto &v: _offset_strides_map) {
@@ -222,6 +269,10 @@ public:
     bool useRandom() const {
         return _useRandom;
     }
+    // Can the kernel assume that the non-temporary arrays are aligned to `BH_MEMORY_ALIGNMENT`?
+    bool assumeAligned() const {
+        return _assumeAligned;
+    }
 };
 
 class Scope {
@@ -237,6 +288,7 @@ private:
     std::set<bh_base*> _declared_base; // Set of bases that have been locally declared (e.g. a temporary variable)
     std::set<bh_view> _declared_view; // Set of views that have been locally declared (e.g. a temporary variable)
     std::set<bh_view, idx_less> _declared_idx; // Set of indexes that have been locally declared
+    std::map<size_t, int> _declared_offset; // Map of offset-and-strides IDs to the rank of their declared offset
 public:
     template<typename T1, typename T2>
     Scope(const SymbolTable &symbols,
@@ -380,6 +432,21 @@ public:
         }
     }
 
+    // Returns the rank of the innermost declared offset of 'view' or -1 when no offset has been declared
+    int getOffsetRank(const bh_view &view) const {
+        if (symbols.existOffsetStridesID(view)) {
+            auto it = _declared_offset.find(symbols.offsetStridesID(view));
+            if (it != _declared_offset.end()) {
+                return it->second;
+            }
+        }
+        if (parent != NULL) {
+            return parent->getOffsetRank(view);
+        } else {
+            return -1;
+        }
+    }
+
     // Get the name (symbol) of the 'base'
     template <typename T>
     void getName(const bh_view &view, T &out) const {
@@ -433,6 +500,21 @@ public:
 
     // Write the variable declaration of the index calculation of 'view' using 'type_str' as the type string
     void writeIdxDeclaration(const bh_view &view, const std::string &type_str, std::stringstream &out);
+
+    // Get the name (symbol) of the offset of 'view' at 'rank', which is the part of the index of 'view'
+    // that the loops within 'rank' doesn't change
+    template <typename T>
+    void getOffsetName(const bh_view &view, int rank, T &out) const {
+        out << "vo" << symbols.offsetStridesID(view) << "_" << rank;
+    }
+
+    // Write the variable declaration of the offset of 'view' at 'rank' using 'type_str' as the type string
+    void writeOffsetDeclaration(const bh_view &view, int rank, const std::string &type_str, std::stringstream &out);
+
+    // Forget the offsets declared in this scope, which we must do when the for-loop that declares them ends
+    void clearOffsetDeclarations() {
+        _declared_offset.clear();
+    }
 };
 
 
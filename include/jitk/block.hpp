@@ -63,6 +63,9 @@ public:
     std::set<bh_base *> _frees;
     // Is this loop and all its sub-blocks reshapable
     bool _reshapable = false;
+    // The tile size when the loop is strip-mined by the `tile()` transformer (zero means not tiled). The loop then
+    // iterates within one tile while the loop over the tiles goes around the loop nest (see `get_tiled_loops()`)
+    int64_t tile = 0;
 
     // Unique id of this block
     int _id;
@@ -295,6 +298,14 @@ std::pair<uint64_t, uint64_t> parallel_ranks(const LoopB &block, unsigned int ma
 void get_first_loop_blocks(const LoopB &block, std::vector<const LoopB*> &out);
 std::vector<const LoopB*> get_first_loop_blocks(const LoopB &block);
 
+// Return the tiled loops of the loop nest `block` (see the `tile()` transformer) from the outermost to the innermost.
+// The loops over the tiles of these loops go around `block` in that order.
+std::vector<const LoopB*> get_tiled_loops(const LoopB &block);
+
+// Return all loop blocks in `block_list` (incl. nested blocks) in depth-first order.
+// This is the order of the loop size variables when `shape_as_var` is enabled.
+std::vector<const LoopB*> get_all_loop_blocks(const std::vector<Block> &block_list);
+
 // Check if the two blocks 'b1' and 'b2' (in that order) are mergeable.
 // 'avoid_rank0_sweep' will not allow fusion of sweeped and non-sweeped blocks at the root level
 bool mergeable(const Block &b1, const Block &b2, bool avoid_rank0_sweep);
@@ -21,6 +21,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <map>
 #include <string>
+#include <boost/filesystem/path.hpp>
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
@@ -35,10 +36,22 @@ private:
     std::map<size_t, std::string> _cache;
     // Some statistics
     jitk::Statistics &stat;
+
+    // Directory where cache entries persist between executions (empty means disabled)
+    boost::filesystem::path _persist_dir;
+    // Hash of the configuration that the persistent cache entries must match
+    uint64_t _persist_hash = 0;
 public:
     // The constructor takes the statistic object
     CodegenCache(jitk::Statistics &stat) : stat(stat) {}
 
+    // Let the cache persist between executions by storing it in `dir`.
+    // `config_hash` should identify the configuration of the code generator.
+    void setPersistentDir(const boost::filesystem::path &dir, uint64_t config_hash) {
+        _persist_dir = dir;
+        _persist_hash = config_hash;
+    }
+
     // Check the cache for a source code that matches 'instr_list'
     // Returns the source code and the hash of the source.
     // On cache misses, the returned source is an empty string.
@@ -101,6 +101,39 @@ boost::filesystem::path write_source2file(const std::string &src,
                                           const std::string &filename,
                                           bool verbose);
 
+// Write `data` to `path` atomically by writing a temporary file in the same directory and renaming it.
+// Useful when multiple processes share the same directory
+void write_file_atomically(const std::string &data, const boost::filesystem::path &path);
+
+// Returns the content of the file `path` or the empty string if the file cannot be read
+std::string read_file(const boost::filesystem::path &path);
+
+// Copy `src` to `dst` atomically by copying to a temporary file next to `dst` and renaming it
+void copy_file_atomically(const boost::filesystem::path &src, const boost::filesystem::path &dst);
+
+// Returns `seed` mixed with the path, size, and modification time of `path`, which identifies a build of the file.
+// Returns `seed` unchanged if `path` doesn't exist.
+uint64_t file_build_hash(const boost::filesystem::path &path, uint64_t seed = 0);
+
+// Returns `seed` mixed with the build of the Bohrium library (the fusers) and the build of `library` (the code
+// generator of a vector engine). Rebuilding Bohrium changes the hash even when the version stays the same.
+uint64_t build_hash(const boost::filesystem::path &library, uint64_t seed = 0);
+
+// An exclusive lock shared between processes through the lock file `path`.
+// The constructor blocks until the lock is acquired and the destructor removes the lock file and releases the lock.
+// NB: a process might acquire the lock of a removed lock file thus the guarded work must check whether it is
+//     still needed after acquiring the lock.
+class FileLock {
+private:
+    const boost::filesystem::path _path;
+    int _fd;
+public:
+    explicit FileLock(boost::filesystem::path path);
+    ~FileLock();
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+};
+
 // Returns the path to the tmp dir
 boost::filesystem::path get_tmp_path(const ConfigParser &config);
 
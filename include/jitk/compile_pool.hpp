@@ -0,0 +1,95 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <exception>
+#include <condition_variable>
+
+namespace bohrium {
+namespace jitk {
+
+/**
+ * A pool of worker threads that runs compile jobs in the background.
+ * Jobs are identified by a key (typically the hash of the kernel source) and
+ * the caller collects a job through `wait()` before using its result.
+ */
+class CompilePool {
+private:
+    struct Job {
+        enum class State {QUEUED, RUNNING, DONE};
+        std::function<void()> func;
+        State state = State::QUEUED;
+        std::exception_ptr error;
+        std::chrono::duration<double> time{0};
+    };
+
+    std::map<uint64_t, std::shared_ptr<Job>> _jobs;
+    std::deque<uint64_t> _queue;
+    std::vector<std::thread> _workers;
+    mutable std::mutex _mutex;
+    std::condition_variable _cond_queue;
+    std::condition_variable _cond_done;
+    bool _shutdown = false;
+
+    // The main loop of each worker thread
+    void worker();
+
+    // Run `job` in the calling thread and record its time and exception
+    static void run(Job &job);
+
+public:
+    // Start `num_workers` worker threads. Zero workers disables the pool.
+    explicit CompilePool(unsigned int num_workers);
+
+    // Drops the queued jobs and joins the workers
+    ~CompilePool() { shutdown(); }
+
+    // Returns true when the pool has worker threads
+    bool enabled() const { return not _workers.empty(); }
+
+    // Enqueue `job` under `key`. Nothing happens when `key` has already been submitted.
+    void submit(uint64_t key, std::function<void()> job);
+
+    // Returns true when a job with `key` has been submitted but not collected
+    bool exist(uint64_t key) const;
+
+    // Returns true when the job with `key` has finished
+    bool ready(uint64_t key) const;
+
+    /* Wait for the job `key` to finish and remove it from the pool.
+     * If no worker has picked up the job yet, it is run in the calling thread.
+     * Returns the amount of the job's runtime that was not spent waiting, i.e. the time hidden
+     * in the background. Rethrows any exception the job threw.
+     */
+    std::chrono::duration<double> wait(uint64_t key);
+
+    // Drops the queued jobs and joins the workers after they finish their current job
+    void shutdown();
+};
+
+}} // namespace
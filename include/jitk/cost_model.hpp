@@ -0,0 +1,109 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <set>
+#include <memory>
+
+#include <jitk/block.hpp>
+#include <bh_config_parser.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+// The memory traffic of a block, which is what the cost models estimate the cost of a block from
+struct BlockTraffic {
+    // Bytes accessed of each non-temporary array (strided accesses count whole cache lines)
+    std::map<const bh_base*, uint64_t> bytes;
+    // New and freed arrays in the block
+    std::set<bh_base*> news, frees;
+    // The amount of parallelism (see `parallel_ranks()`)
+    uint64_t threading = 1;
+    // Number of elements accessed indirectly (gather and scatter)
+    uint64_t indirect = 0;
+};
+
+// Returns the memory traffic of `block` where `cache_line` is the size of a cache line in bytes
+BlockTraffic block_traffic(const Block &block, uint64_t cache_line);
+
+// Returns the memory traffic of the block that merges the blocks of `t1` and `t2` (in that order)
+BlockTraffic merge_traffic(const BlockTraffic &t1, const BlockTraffic &t2);
+
+// The interface of the cost models that the fusers use to prioritize the merges
+class CostModel {
+public:
+    virtual ~CostModel() = default;
+
+    // Returns the estimated cost of executing a block with the memory traffic `traffic`
+    virtual double cost(const BlockTraffic &traffic) const = 0;
+
+    // Returns the size of a cache line, which `block_traffic()` needs
+    virtual uint64_t cacheLine() const = 0;
+
+    // Returns the cost saved by merging the blocks of `t1` and `t2` (in that order).
+    // A negative benefit means that the merge makes things worse.
+    double benefit(const BlockTraffic &t1, const BlockTraffic &t2) const {
+        return cost(t1) + cost(t2) - cost(merge_traffic(t1, t2));
+    }
+};
+
+// The cost is the number of bytes accessed, thus the benefit of a merge is the bytes saved regardless of the machine
+class BytesCostModel : public CostModel {
+public:
+    double cost(const BlockTraffic &traffic) const override;
+    uint64_t cacheLine() const override { return 1; }
+};
+
+/* The cost is the estimated execution time in seconds on the machine described by the following config options,
+ * which `bh_openmp_calibrate` measures and writes to the config file:
+ *   - machine_dram_bandwidth:    the bandwidth of main memory (bytes/sec)
+ *   - machine_cache_bandwidth:   the bandwidth of the last level cache (bytes/sec)
+ *   - machine_cache_size:        the size of the last level cache (bytes)
+ *   - machine_cache_line:        the size of a cache line (bytes)
+ *   - machine_memory_latency:    the latency of a random memory access (sec)
+ *   - machine_parallel_overhead: the overhead of a kernel launch incl. the start of a parallel region (sec)
+ *   - machine_threads:           the number of threads that executes a kernel
+ * and
+ *   - cost_max_streams:          the number of arrays a block can stream before the hardware prefetchers and
+ *                                registers runs out, which slows down the block
+ */
+class TrafficCostModel : public CostModel {
+public:
+    const double dram_bandwidth;
+    const double cache_bandwidth;
+    const uint64_t cache_size;
+    const uint64_t cache_line;
+    const double memory_latency;
+    const double parallel_overhead;
+    const uint64_t num_threads;
+    const uint64_t max_streams;
+
+    explicit TrafficCostModel(const ConfigParser &config);
+
+    double cost(const BlockTraffic &traffic) const override;
+    uint64_t cacheLine() const override { return cache_line; }
+};
+
+// Returns the cost model specified by the `cost_model` option in `config`
+std::unique_ptr<CostModel> create_cost_model(const ConfigParser &config);
+
+} // jitk
+} // bohrium
@@ -19,12 +19,16 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <stdexcept>
+
+#include <bh_version.h>
 #include <bh_config_parser.hpp>
 #include <jitk/statistics.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
 #include <bh_instruction.hpp>
+#include <bh_memory.h>
 #include <boost/filesystem.hpp>
 
 namespace bohrium {
@@ -56,6 +60,9 @@ protected:
     // The hash of the JIT compilation command
     uint64_t compilation_hash;
 
+    // Whether `writeLoopBlock()` is writing a tiled loop nest within the loops over its tiles
+    bool _within_tiles = false;
+
 public:
     Engine(const ConfigParser &config, Statistics &stat) :
       config(config),
@@ -69,12 +76,33 @@ public:
       tmp_bin_dir(tmp_dir / "obj"),
       cache_bin_dir(config.defaultGet<boost::filesystem::path>("cache_dir", "")),
       compilation_hash(0) {
+        // The host memory of the arrays is recycled through a pool (see `bh_memory_malloc()`)
+        bh_memory_pool_config(config.defaultGet<uint64_t>("mem_pool_max_retained", 256 * 1024 * 1024),
+                              config.defaultGet<uint64_t>("mem_pool_hugepage_threshold", 0));
+
         // Let's make sure that the directories exist
         jitk::create_directories(tmp_src_dir);
         jitk::create_directories(tmp_bin_dir);
 
         if (not cache_bin_dir.empty()) {
             jitk::create_directories(cache_bin_dir);
+
+            // Let the fuse and codegen caches persist between executions. The cache entries are only valid
+            // for the Bohrium build and the configuration options that affect fusion and codegen.
+            if (config.defaultGet<bool>("persistent_cache", true)) {
+                const uint64_t config_hash = config.hashOfSection({"verbose", "prof", "prof_filename", "graph",
+                                                                  "tmp_dir", "cache_dir", "cache_file_max",
+                                                                  "persistent_cache", "compiler_workers",
+                                                                  "compiler_fallback_cmd", "libs",
+                                                                  "mem_pool_max_retained",
+                                                                  "mem_pool_hugepage_threshold",
+                                                                  "spill_dir", "spill_threshold", "stream_budget",
+                                                                  "thread_pool_size", "pin_threads", "numa_policy"});
+                const uint64_t persist_hash = jitk::build_hash(config.defaultGet<boost::filesystem::path>("impl", ""),
+                                                               util::hash(BH_VERSION_STRING, config_hash));
+                fcache.setPersistentDir(cache_bin_dir, persist_hash);
+                codegen_cache.setPersistentDir(cache_bin_dir, persist_hash);
+            }
         }
     }
 
@@ -85,9 +113,12 @@ public:
     virtual void setConstructorFlag(std::vector<bh_instruction*> &instr_list) = 0;
 
 protected:
+    // Writes the arguments of the kernel function. When `num_extents` is non-zero, the loop sizes and the
+    // sizes of the kernel temporaries are arguments as well (see `shape_as_var`).
     void writeKernelFunctionArguments(const jitk::SymbolTable &symbols,
                                       std::stringstream &ss,
-                                      const char *array_type_prefix) {
+                                      const char *array_type_prefix,
+                                      size_t num_extents = 0) {
         // We create the comma separated list of args and saves it in `stmp`
         std::stringstream stmp;
         for (size_t i = 0; i < symbols.getParams().size(); ++i) {
@@ -106,6 +137,10 @@ protected:
             }
         }
 
+        for (size_t i = 0; i < num_extents; ++i) {
+            stmp << "const " << writeType(bh_type::UINT64) << " e" << i << ", ";
+        }
+
         if (not symbols.constIDs().empty()) {
             for (auto it = symbols.constIDs().begin(); it != symbols.constIDs().end(); ++it) {
                 const InstrPtr &instr = *it;
@@ -139,6 +174,22 @@ protected:
             return;
         }
 
+        // A tiled loop nest is written within the loops over its tiles (see `get_tiled_loops()`)
+        if (block.rank == 0 and not _within_tiles) {
+            const vector<const LoopB*> tiled = get_tiled_loops(block);
+            if (not tiled.empty()) {
+                tileHeadWriter(symbols, tiled, out);
+                _within_tiles = true;
+                writeLoopBlock(symbols, parent_scope, block, thread_stack, opencl, out);
+                _within_tiles = false;
+                for (size_t i = 0; i < tiled.size(); ++i) {
+                    util::spaces(out, 4);
+                    out << "}\n";
+                }
+                return;
+            }
+        }
+
         // Order all sweep instructions by the viewID of their first operand.
         // This makes the source of the kernels more identical, which improve the code and compile caches.
         const vector<jitk::InstrPtr> ordered_block_sweeps = order_sweep_set(block._sweeps, symbols);
@@ -220,7 +271,8 @@ protected:
             util::spaces(out, 4 + block.rank * 4);
             out << "{ // Peeled loop, 1. sweep iteration\n";
             util::spaces(out, 8 + block.rank*4);
-            out << writeType(bh_type::UINT64) << " " << itername << " = 0;\n";
+            out << writeType(bh_type::UINT64) << " " << itername << " = " << loopBegin(block) << ";\n";
+            writeOffsetDeclarations(symbols, peeled_scope, peeled_block, out);
 
             // Write temporary and scalar replaced array declarations
             for (const InstrPtr &instr: block.getLocalInstr()) {
@@ -267,6 +319,7 @@ protected:
         // Write the for-loop header
         util::spaces(out, 4 + block.rank*4);
         loopHeadWriter(symbols, scope, block, peel, thread_stack, out);
+        writeOffsetDeclarations(symbols, scope, block, out);
 
         // Write temporary and scalar replaced array declarations
         for (const InstrPtr &instr: block.getLocalInstr()) {
@@ -333,6 +386,7 @@ protected:
         }
         util::spaces(out, 4 + block.rank*4);
         out << "}\n";
+        scope.clearOffsetDeclarations();
 
         // Let's copy the scalar replaced reduction outputs back to the original array
         for (const bh_view *view: scalar_replaced_reduction_outputs) {
@@ -345,6 +399,10 @@ protected:
         }
     }
 
+    // Returns the first iteration of the for-loop of `block`, which is the iteration that the loop peeling writes.
+    // The `loopHeadWriter()` must start the for-loop at the iteration following it.
+    virtual std::string loopBegin(const LoopB &block) { return "0"; }
+
     virtual void loopHeadWriter(const SymbolTable &symbols,
                                 Scope &scope,
                                 const LoopB &block,
@@ -352,7 +410,47 @@ protected:
                                 const std::vector<uint64_t> &thread_stack,
                                 std::stringstream &out) = 0;
 
+    // Writes the heads of the loops over the tiles of the `tiled` loops, which `writeLoopBlock()` closes.
+    // The loop over the tiles of the loop `i<rank>` must be named `i<rank>_tile`.
+    // NB: only engines that supports the `tile` transformer implement this function
+    virtual void tileHeadWriter(const SymbolTable &symbols,
+                                const std::vector<const LoopB*> &tiled,
+                                std::stringstream &out) {
+        throw std::runtime_error("The engine doesn't support tiled loops (the `tile` transformer)");
+    }
+
 private:
+    // Writes the offsets of the arrays that the loops within `block` access (see `offsets_as_var`), which makes
+    // the index calculations of the inner loops add the strides of their own axes only
+    void writeOffsetDeclarations(const SymbolTable &symbols, Scope &scope, const LoopB &block, std::stringstream &out) {
+        if (not symbols.offsets_as_var) {
+            return;
+        }
+        for (const InstrPtr &instr: block.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode) or instr->opcode == BH_GATHER or
+                instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+                continue;
+            }
+            for (size_t o = 0; o < instr->operand.size(); ++o) {
+                const bh_view &view = instr->operand[o];
+                // NB: reductions to non-scalars write their output using a hidden axis
+                if (bh_is_constant(&view) or bh_is_scalar(&view) or view.ndim - 1 <= block.rank or
+                    not scope.isArray(view) or not symbols.existOffsetStridesID(view) or
+                    (o == 0 and bh_opcode_is_reduction(instr->opcode) and instr->operand[1].ndim > 1)) {
+                    continue;
+                }
+                // NB: without strides as variables, an axis with a zero stride doesn't change the offset
+                if (scope.getOffsetRank(view) >= block.rank or
+                    (not symbols.strides_as_var and view.stride[block.rank] == 0)) {
+                    continue;
+                }
+                util::spaces(out, 8 + block.rank * 4);
+                scope.writeOffsetDeclaration(view, static_cast<int>(block.rank), writeType(bh_type::UINT64), out);
+                out << "\n";
+            }
+        }
+    }
+
     bool needToPeel(const std::vector<InstrPtr> &ordered_block_sweeps, const Scope &scope) {
         for (const InstrPtr &instr: ordered_block_sweeps) {
             const bh_view &v = instr->operand[0];
@@ -19,22 +19,50 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <algorithm>
+#include <deque>
+
 #include "engine.hpp"
 
 #include <bh_config_parser.hpp>
 #include <jitk/statistics.hpp>
+#include <jitk/transformer.hpp>
+#include <jitk/memory_plan.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
 #include <bh_instruction.hpp>
+#include <bh_memory.h>
 
 namespace bohrium {
 namespace jitk {
 
 class EngineCPU : public Engine {
+private:
+    // The maximum number of specialized kernels of each generic kernel (tiered JIT)
+    const uint64_t tier_max_variants;
+    // Map of a generic kernel (its codegen hash) to its number of specialized kernels
+    std::map<uint64_t, uint64_t> _tier_variants;
+    // Kernels that access arrays of `spill_threshold` bytes or more are executed chunk by chunk such that
+    // the chunks of the arrays fit in `stream_budget` bytes (see `executeStreaming()`). Zero disables streaming.
+    const uint64_t spill_threshold;
+    const uint64_t stream_budget;
+
+protected:
+    // Whether the arrays that live within a flush get their memory from a `MemoryPlan`
+    const bool mem_plan;
+
 public:
     EngineCPU(const ConfigParser &config, Statistics &stat) :
-      Engine(config, stat) {
+      Engine(config, stat),
+      tier_max_variants(config.defaultGet<uint64_t>("tier_max_variants", 8)),
+      spill_threshold(config.defaultGet<std::string>("spill_dir", "").empty() ? 0 :
+                      config.defaultGet<uint64_t>("spill_threshold", 1024ul * 1024 * 1024)),
+      stream_budget(config.defaultGet<uint64_t>("stream_budget", 256ul * 1024 * 1024)),
+      mem_plan(config.defaultGet<bool>("mem_plan", true)) {
+        // Arrays that are too large for the memory are backed by files (see `bh_memory_spill_config()`)
+        bh_memory_spill_config(config.defaultGet<std::string>("spill_dir", "").c_str(),
+                               config.defaultGet<uint64_t>("spill_threshold", 1024ul * 1024 * 1024));
     }
 
     virtual ~EngineCPU() {}
@@ -45,23 +73,42 @@ public:
                              uint64_t codegen_hash,
                              std::stringstream &ss) = 0;
 
+    // Execute the kernel `source` where `work` is the number of iterations of its loop nests (see `kernelWork()`)
     virtual void execute(const std::string &source,
                          uint64_t codegen_hash,
                          const std::vector<bh_base*> &non_temps,
                          const std::vector<const bh_view*> &offset_strides,
-                         const std::vector<const bh_instruction*> &constants) = 0;
+                         const std::vector<uint64_t> &extents,
+                         const std::vector<const bh_instruction*> &constants,
+                         uint64_t work) = 0;
+
+    // Hint that the kernel `source` is about to be executed, which makes it possible for the engine
+    // to compile the kernel in the background. The default implementation does nothing.
+    virtual void prefetch(const std::string &source, uint64_t codegen_hash) {}
+
+    // Tiered JIT: returns true when the generic kernel `source` has been executed enough to be worth specializing.
+    // The default implementation never tiers up.
+    virtual bool isHot(const std::string &source) { return false; }
+
+    // Tiered JIT: execute the kernel `source`, which is `generic_source` specialized with hard-coded shapes, strides,
+    // and constants. If the specialized kernel isn't compiled yet, the engine should compile it in the background
+    // and return false thus the generic kernel is executed instead.
+    virtual bool executeSpecialized(const std::string &source,
+                                    uint64_t codegen_hash,
+                                    const std::vector<bh_base*> &non_temps,
+                                    const std::string &generic_source,
+                                    uint64_t work) { return false; }
+
+    // Hint that the following launches execute a kernel chunk by chunk (see `executeStreaming()`), which also
+    // streams the arrays in and out thus the launches shouldn't be replayed as-is. The default does nothing.
+    virtual void beginStreaming() {}
 
     virtual void handleExecution(BhIR *bhir) {
         using namespace std;
 
         const auto texecution = chrono::steady_clock::now();
 
-        map<string, bool> kernel_config = {
-            { "strides_as_var", config.defaultGet<bool>("strides_as_var", true) },
-            { "index_as_var",   config.defaultGet<bool>("index_as_var",   true) },
-            { "const_as_var",   config.defaultGet<bool>("const_as_var",   true) },
-            { "use_volatile",   config.defaultGet<bool>("use_volatile",  false) }
-        };
+        map<string, bool> kernel_config = kernelConfig();
 
         // Some statistics
         stat.record(*bhir);
@@ -88,6 +135,7 @@ public:
 
         // Let's get the block list
         const vector<jitk::Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
+        stat.record(block_list);
 
         if (config.defaultGet<bool>("monolithic", false)) {
             createMonolithicKernel(kernel_config, block_list);
@@ -97,6 +145,48 @@ public:
         stat.time_total_execution += chrono::steady_clock::now() - texecution;
     }
 
+    // Executes the repeats of `bhir` (see `BhIR::getNRepeats()`) `time_tile_steps` at a time in time-tiled kernels,
+    // which execute all steps on a chunk of rows before moving on to the next chunk (see `time_tile()`).
+    // Returns the number of repeats executed, which is zero when the repeats cannot be time-tiled.
+    uint64_t handleTimeTiling(BhIR *bhir) {
+        using namespace std;
+
+        const int64_t steps = config.defaultGet<int64_t>("time_tile_steps", 4);
+        if (steps < 2 or bhir->getRepeatCondition() != nullptr or bhir->getNRepeats() < static_cast<uint64_t>(steps)) {
+            return 0;
+        }
+        const auto texecution = chrono::steady_clock::now();
+        map<string, bool> kernel_config = kernelConfig();
+
+        // Let's get the block list of a single repeat like `handleExecution()` does
+        set<bh_base*> frees;
+        vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(bhir->instr_list, frees);
+        if (config.defaultGet<bool>("array_contraction", true)) {
+            setConstructorFlag(instr_list);
+        } else {
+            for (bh_instruction *instr: instr_list) {
+                instr->constructor = false;
+            }
+        }
+        const vector<jitk::Block> block_list = get_block_list(instr_list, config, fcache, stat, false);
+        const StripMine time_tiles = time_tile(block_list, getKernelTemps(block_list), steps,
+                                               config.defaultGet<uint64_t>("tile_cache_size", 0));
+        if (time_tiles.rows == 0) {
+            stat.time_total_execution += chrono::steady_clock::now() - texecution;
+            return 0;
+        }
+        for(bh_base *base: frees) {
+            bh_data_free(base);
+        }
+        const uint64_t launches = bhir->getNRepeats() / steps;
+        for (uint64_t i = 0; i < launches * steps; ++i) {
+            stat.record(*bhir);
+        }
+        createMonolithicKernel(kernel_config, block_list, time_tiles, launches);
+        stat.time_total_execution += chrono::steady_clock::now() - texecution;
+        return launches * steps;
+    }
+
     template <typename T>
     void handleExtmethod(T &comp, BhIR *bhir) {
         std::vector<bh_instruction> instr_list;
@@ -120,38 +210,91 @@ public:
     }
 
 private:
+    // Returns the configuration of the kernels (see `SymbolTable`)
+    std::map<std::string, bool> kernelConfig() {
+        return {
+            { "strides_as_var", config.defaultGet<bool>("strides_as_var", true) },
+            { "index_as_var",   config.defaultGet<bool>("index_as_var",   true) },
+            { "const_as_var",   config.defaultGet<bool>("const_as_var",   true) },
+            { "shape_as_var",   config.defaultGet<bool>("shape_as_var",  false) },
+            { "offsets_as_var", config.defaultGet<bool>("offsets_as_var", true) },
+            { "assume_aligned", config.defaultGet<bool>("assume_aligned", true) },
+            { "use_volatile",   config.defaultGet<bool>("use_volatile",  false) }
+        };
+    }
+
     void createKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list) {
         using namespace std;
 
-        // When creating a regular kernels (a block-nest per shared library), we create one kernel at a time
-        for(const Block &block: block_list) {
+        // When creating a regular kernels (a block-nest per shared library), we first create the symbol table
+        // and the source code of every kernel. This way, the engine can start compiling kernels in the background
+        // (see `prefetch()`) while earlier kernels execute.
+        // NB: we use a deque because it never moves its elements, which the symbol tables doesn't support
+        deque<SymbolTable> symbol_tables;
+        vector<pair<string, uint64_t> > sources(block_list.size());
+        vector<bool> streaming(block_list.size());
+        for(size_t i = 0; i < block_list.size(); ++i) {
+            const Block &block = block_list[i];
             assert(not block.isInstr());
+            streaming[i] = isStreamable(block);
 
             // Let's create the symbol table for the kernel
-            const SymbolTable symbols(
+            // NB: the chunks of a streamed kernel differ in their offsets and the size of the outermost loop only
+            symbol_tables.emplace_back(
                 block.getAllInstr(),
                 block.getLoop().getAllNonTemps(),
                 kernel_config["use_volatile"],
-                kernel_config["strides_as_var"],
-                kernel_config["index_as_var"],
-                kernel_config["const_as_var"]
+                kernel_config["strides_as_var"] or streaming[i],
+                kernel_config["index_as_var"] or streaming[i],
+                kernel_config["const_as_var"],
+                kernel_config["shape_as_var"] or streaming[i],
+                kernel_config["offsets_as_var"],
+                kernel_config["assume_aligned"]
             );
+            stat.record(symbol_tables.back());
 
-            stat.record(symbols);
+            if (not block.isSystemOnly()) { // We can skip this step if the kernel does no computation
+                sources[i] = getKernelSource({ block }, symbol_tables.back(), {});
+                prefetch(sources[i].first, sources[i].second);
+            }
+        }
+
+        // The arrays that are both accessed and freed by the kernels get their memory from a plan, where the steps
+        // of the plan are the kernels
+        vector<bh_base*> arrays;
+        MemoryPlan memory_plan;
+        if (mem_plan) {
+            vector<pair<const SymbolTable*, bool> > launches;
+            for(size_t i = 0; i < block_list.size(); ++i) {
+                launches.emplace_back(&symbol_tables[i], not block_list[i].isSystemOnly());
+            }
+            memory_plan = planMemory(launches, arrays);
+        }
+        MemoryPlan::Execution memory(memory_plan, stat);
+
+        // Then we execute the kernels one at a time
+        for(size_t i = 0; i < block_list.size(); ++i) {
+            const SymbolTable &symbols = symbol_tables[i];
+            memory.assign(i, arrays);
 
             // Let's execute the kernel
-            if (not block.isSystemOnly()) { // We can skip this step if the kernel does no computation
-                executeKernel({ block }, symbols, {});
+            if (streaming[i]) {
+                executeStreaming(block_list[i].getLoop(), sources[i], symbols);
+            } else if (not block_list[i].isSystemOnly()) {
+                executeKernel(kernel_config, { block_list[i] }, {}, sources[i], symbols);
             }
 
             // Finally, let's cleanup
             for(bh_base *base: symbols.getFrees()) {
-                bh_data_free(base);
+                memory.free(base);
             }
         }
     }
 
-    void createMonolithicKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list) {
+    // Creates and executes the kernel of all blocks in `block_list`. A time-tiled kernel (see `time_tile()`)
+    // executes its time steps `launches` times.
+    void createMonolithicKernel(std::map<std::string, bool> kernel_config, const std::vector<Block> &block_list,
+                                StripMine time_tiles = StripMine(), uint64_t launches = 1) {
         using namespace std;
 
         // When creating a monolithic kernel (all instructions in one shared library), we first combine
@@ -168,16 +311,15 @@ private:
             }
         }
         // Let's find the arrays that are allocated and freed between blocks in the kernel
-        vector<bh_base*> kernel_temps;
-        set<bh_base*> constructors;
-        for(const InstrPtr &instr: all_instr) {
-            if (instr->constructor) {
-                assert(instr->operand[0].base != NULL);
-                constructors.insert(instr->operand[0].base);
-            } else if (instr->opcode == BH_FREE and util::exist(constructors, instr->operand[0].base)) {
-                kernel_temps.push_back(instr->operand[0].base);
-                all_non_temps.erase(instr->operand[0].base);
-            }
+        const vector<bh_base*> kernel_temps = getKernelTemps(block_list);
+        for (bh_base *base: kernel_temps) {
+            all_non_temps.erase(base);
+        }
+
+        // The kernel temporaries only need to hold a chunk of rows when the kernel is strip-mined
+        StripMine strip = std::move(time_tiles);
+        if (strip.rows == 0 and config.defaultGet<bool>("strip_mine", true)) {
+            strip = strip_mine(block_list, kernel_temps, config.defaultGet<uint64_t>("tile_cache_size", 0));
         }
 
         // Let's create the symbol table for the kernel
@@ -187,32 +329,237 @@ private:
             kernel_config["use_volatile"],
             kernel_config["strides_as_var"],
             kernel_config["index_as_var"],
-            kernel_config["const_as_var"]
+            kernel_config["const_as_var"],
+            kernel_config["shape_as_var"],
+            kernel_config["offsets_as_var"],
+            kernel_config["assume_aligned"],
+            std::move(strip)
         );
         stat.record(symbols);
 
         // Let's execute the kernel
+        pair<string, uint64_t> source;
         if (kernel_is_computing) { // We can skip this step if the kernel does no computation
-            executeKernel(block_list, symbols, kernel_temps);
+            source = getKernelSource(block_list, symbols, kernel_temps);
+            prefetch(source.first, source.second);
         }
 
-        // Finally, let's cleanup
-        for(bh_base *base: symbols.getFrees()) {
-            bh_data_free(base);
+        // The arrays that a launch creates and frees get their memory from a plan, where the steps of the plan are
+        // the launches, thus the arrays of a repeated launch get the buffers of the arrays freed by the launch before
+        vector<bh_base*> arrays;
+        MemoryPlan memory_plan;
+        if (mem_plan) {
+            memory_plan = planMemory(vector<pair<const SymbolTable*, bool> >(launches, {&symbols, kernel_is_computing}),
+                                     arrays);
+        }
+        MemoryPlan::Execution memory(memory_plan, stat);
+
+        for (uint64_t i = 0; i < launches; ++i) {
+            memory.assign(i, arrays);
+            if (kernel_is_computing) {
+                executeKernel(kernel_config, block_list, kernel_temps, source, symbols);
+            }
+
+            // Finally, let's cleanup
+            for(bh_base *base: symbols.getFrees()) {
+                memory.free(base);
+            }
         }
     }
 private:
-    void executeKernel(const std::vector<Block> &block_list,
-                       const SymbolTable &symbols,
-                       std::vector<bh_base*> kernel_temps) {
+    // Returns the memory plan of a sequence of kernel launches where `launches[i]` is the symbol table of launch `i`
+    // and whether the launch does any computation. The IDs of the arrays in the plan are their indexes in `arrays`.
+    // NB: a base that is freed and accessed again, e.g. by a repeated kernel, gets a new ID after its free
+    static MemoryPlan planMemory(const std::vector<std::pair<const SymbolTable*, bool> > &launches,
+                                 std::vector<bh_base*> &arrays) {
+        std::map<bh_base*, size_t> ids;
+        std::vector<uint64_t> sizes;
+        std::vector<std::vector<size_t> > accesses(launches.size()), frees(launches.size());
+        const auto id = [&](bh_base *base) -> size_t {
+            auto it = ids.find(base);
+            if (it == ids.end()) {
+                it = ids.insert(std::make_pair(base, arrays.size())).first;
+                arrays.push_back(base);
+                sizes.push_back(static_cast<uint64_t>(bh_base_size(base)));
+            }
+            return it->second;
+        };
+        for (size_t i = 0; i < launches.size(); ++i) {
+            if (launches[i].second) {
+                for (bh_base *base: launches[i].first->getParams()) {
+                    accesses[i].push_back(id(base));
+                }
+            }
+            for (bh_base *base: launches[i].first->getFrees()) {
+                frees[i].push_back(id(base));
+                ids.erase(base);
+            }
+        }
+        return MemoryPlan(sizes, accesses, frees);
+    }
+
+    // Returns the arrays that are allocated and freed between the blocks of a kernel consisting of `block_list`
+    static std::vector<bh_base*> getKernelTemps(const std::vector<Block> &block_list) {
+        std::vector<InstrPtr> all_instr;
+        for (const Block &block: block_list) {
+            block.getAllInstr(all_instr);
+        }
+        std::vector<bh_base*> ret;
+        std::set<bh_base*> constructors;
+        for (const InstrPtr &instr: all_instr) {
+            if (instr->constructor) {
+                assert(instr->operand[0].base != NULL);
+                constructors.insert(instr->operand[0].base);
+            } else if (instr->opcode == BH_FREE and util::exist(constructors, instr->operand[0].base)) {
+                ret.push_back(instr->operand[0].base);
+            }
+        }
+        return ret;
+    }
+
+    // Returns true when `block` accesses an array of `spill_threshold` bytes or more and its outermost loop can be
+    // executed in chunks, which requires independent iterations that index all arrays by their first axis
+    bool isStreamable(const Block &block) const {
+        if (spill_threshold == 0 or block.isSystemOnly()) {
+            return false;
+        }
+        const LoopB &loop = block.getLoop();
+        if (loop.rank != 0 or loop.size < 2 or not loop._sweeps.empty() or not get_tiled_loops(loop).empty()) {
+            return false;
+        }
+        bool large = false;
+        for (const bh_base *base: loop.getAllNonTemps()) {
+            large = large or static_cast<uint64_t>(bh_base_size(base)) >= spill_threshold;
+        }
+        if (not large) {
+            return false;
+        }
+        for (const InstrPtr &instr: loop.getAllInstr()) {
+            if (bh_opcode_is_system(instr->opcode)) {
+                continue;
+            }
+            // These opcodes use the global index or access their arrays at arbitrary indexes
+            if (instr->opcode == BH_RANGE or instr->opcode == BH_RANDOM or instr->opcode == BH_GATHER or
+                instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+                return false;
+            }
+            for (const bh_view *view: instr->get_views()) {
+                if (view->ndim < 1 or view->shape[0] != loop.size) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Returns the iterations of the loop nest `loop`, which we approximate by the sizes of its first loops
+    static uint64_t loopWork(const LoopB &loop) {
+        uint64_t work = 1;
+        for (const LoopB *l: get_first_loop_blocks(loop)) {
+            work *= static_cast<uint64_t>(std::max(int64_t{1}, l->size));
+        }
+        return work;
+    }
+
+    // Returns the iterations of the loop nests of the kernel of `block_list`
+    static uint64_t kernelWork(const std::vector<Block> &block_list) {
+        uint64_t work = 0;
+        for (const Block &block: block_list) {
+            if (not block.isInstr()) {
+                work += loopWork(block.getLoop());
+            }
+        }
+        return work;
+    }
+
+    // Returns the bytes of `view.base` that `view` accesses in the iterations [begin, end) of its first axis
+    static std::pair<uint64_t, uint64_t> chunkRange(const bh_view &view, int64_t begin, int64_t end) {
+        int64_t first = view.start + std::min(begin * view.stride[0], (end - 1) * view.stride[0]);
+        int64_t last = view.start + std::max(begin * view.stride[0], (end - 1) * view.stride[0]);
+        for (int64_t i = 1; i < view.ndim; ++i) {
+            const int64_t extent = (view.shape[i] - 1) * view.stride[i];
+            first += std::min(extent, int64_t{0});
+            last += std::max(extent, int64_t{0});
+        }
+        const int64_t elsize = bh_type_size(view.base->type);
+        return std::make_pair(static_cast<uint64_t>(first * elsize), static_cast<uint64_t>((last + 1) * elsize));
+    }
+
+    // Execute the kernel of `loop` (see `isStreamable()`) chunk by chunk over its outermost loop. While a chunk
+    // executes, the OS reads the next chunk ahead and afterwards the chunk is written back to the spilled arrays
+    // (see `bh_memory_spill_config()`), thus the resident set stays within `stream_budget` bytes.
+    void executeStreaming(const LoopB &loop,
+                          const std::pair<std::string, uint64_t> &source,
+                          const SymbolTable &symbols) {
         using namespace std;
+        beginStreaming();
 
-        // Create the constant vector
         vector<const bh_instruction*> constants;
         constants.reserve(symbols.constIDs().size());
         for (const InstrPtr &instr: symbols.constIDs()) {
             constants.push_back(&(*instr));
         }
+        vector<const LoopB*> loops = {&loop};
+        loop.getAllSubBlocks(loops);
+        vector<uint64_t> extents;
+        for (const LoopB *l: loops) {
+            extents.push_back(static_cast<uint64_t>(l->size));
+        }
+        vector<const bh_view*> views;
+        for (const InstrPtr &instr: loop.getAllInstr()) {
+            if (not bh_opcode_is_system(instr->opcode)) {
+                const vector<const bh_view*> v = instr->get_views();
+                views.insert(views.end(), v.begin(), v.end());
+            }
+        }
+
+        // Let's keep the current and the next chunk within the budget
+        uint64_t iteration_bytes = 0;
+        for (const bh_base *base: symbols.getParams()) {
+            iteration_bytes += static_cast<uint64_t>(bh_base_size(base)) / loop.size;
+        }
+        const int64_t chunk = max(int64_t{1},
+                                  static_cast<int64_t>(stream_budget / 2 / max(uint64_t{1}, iteration_bytes)));
+
+        // The chunks differ in the offsets of the views and the size of the outermost loop
+        vector<bh_view> chunk_views;
+        for (const bh_view *view: symbols.offsetStrideViews()) {
+            chunk_views.push_back(*view);
+        }
+        vector<const bh_view*> offset_strides;
+        for (const bh_view &view: chunk_views) {
+            offset_strides.push_back(&view);
+        }
+
+        for (int64_t begin = 0; begin < loop.size; begin += chunk) {
+            const int64_t end = min(loop.size, begin + chunk);
+            if (end < loop.size) {
+                for (const bh_view *view: views) {
+                    const auto range = chunkRange(*view, end, min(loop.size, end + chunk));
+                    bh_memory_spill_prefetch(view->base->data, range.first, range.second - range.first);
+                }
+            }
+            for (size_t i = 0; i < chunk_views.size(); ++i) {
+                const bh_view &view = *symbols.offsetStrideViews()[i];
+                if (view.ndim > 0) {
+                    chunk_views[i].start = view.start + begin * view.stride[0];
+                }
+            }
+            extents[0] = static_cast<uint64_t>(end - begin);
+            execute(source.first, source.second, symbols.getParams(), offset_strides, extents, constants,
+                    loopWork(loop) / static_cast<uint64_t>(loop.size) * extents[0]);
+            for (const bh_view *view: views) {
+                const auto range = chunkRange(*view, begin, end);
+                bh_memory_spill_evict(view->base->data, range.first, range.second - range.first);
+            }
+        }
+    }
+
+    // Returns the source code of the kernel and its codegen hash (using the codegen cache when possible)
+    std::pair<std::string, uint64_t> getKernelSource(const std::vector<Block> &block_list,
+                                                     const SymbolTable &symbols,
+                                                     const std::vector<bh_base*> &kernel_temps) {
+        using namespace std;
 
         const auto lookup = codegen_cache.get(block_list, symbols);
         if(not lookup.first.empty()) {
@@ -226,7 +573,7 @@ private:
                     assert(1 == 2);
                 }
             #endif
-            execute(lookup.first, lookup.second, symbols.getParams(), symbols.offsetStrideViews(), constants);
+            return lookup;
         } else {
             const auto tcodegen = chrono::steady_clock::now();
             stringstream ss;
@@ -234,9 +581,94 @@ private:
             string source = ss.str();
             stat.time_codegen += chrono::steady_clock::now() - tcodegen;
 
-            execute(source, lookup.second, symbols.getParams(), symbols.offsetStrideViews(), constants);
-            codegen_cache.insert(std::move(source), block_list, symbols);
+            codegen_cache.insert(source, block_list, symbols);
+            return make_pair(std::move(source), lookup.second);
+        }
+    }
+
+    void executeKernel(std::map<std::string, bool> &kernel_config,
+                       const std::vector<Block> &block_list,
+                       const std::vector<bh_base*> &kernel_temps,
+                       const std::pair<std::string, uint64_t> &source,
+                       const SymbolTable &symbols) {
+        using namespace std;
+
+        // Tiered JIT: hot kernels are executed by a specialized kernel when it is ready
+        if (isHot(source.first) and executeTierUp(kernel_config, block_list, kernel_temps, source, symbols.strip)) {
+            return;
+        }
+
+        // Create the constant vector
+        vector<const bh_instruction*> constants;
+        constants.reserve(symbols.constIDs().size());
+        for (const InstrPtr &instr: symbols.constIDs()) {
+            constants.push_back(&(*instr));
+        }
+        // Create the extents vector: the loop sizes followed by the sizes of the kernel temporaries
+        vector<uint64_t> extents;
+        if (symbols.shape_as_var) {
+            for (const LoopB *loop: get_all_loop_blocks(block_list)) {
+                extents.push_back(static_cast<uint64_t>(loop->size));
+            }
+            for (const bh_base *base: kernel_temps) {
+                extents.push_back(static_cast<uint64_t>(base->nelem));
+            }
+        }
+        execute(source.first, source.second, symbols.getParams(), symbols.offsetStrideViews(), extents, constants,
+                kernelWork(block_list));
+    }
+
+    // Execute the kernel specialized with hard-coded shapes, strides, and constants (i.e. all `*_as_var` disabled
+    // except `index_as_var`), which is strip-mined like the generic kernel (`strip`). Returns false when the
+    // specialized kernel isn't ready or when the generic kernel `generic` has too many specialized kernels already.
+    bool executeTierUp(std::map<std::string, bool> &kernel_config,
+                       const std::vector<Block> &block_list,
+                       const std::vector<bh_base*> &kernel_temps,
+                       const std::pair<std::string, uint64_t> &generic,
+                       const StripMine &strip) {
+        using namespace std;
+
+        vector<InstrPtr> instr_list;
+        set<bh_base*> non_temps;
+        for (const Block &block: block_list) {
+            block.getAllInstr(instr_list);
+            block.getLoop().getAllNonTemps(non_temps);
+        }
+        for (bh_base *base: kernel_temps) {
+            non_temps.erase(base);
+        }
+        const SymbolTable symbols(
+            instr_list,
+            non_temps,
+            kernel_config["use_volatile"],
+            false,
+            kernel_config["index_as_var"],
+            false,
+            false,
+            kernel_config["offsets_as_var"],
+            kernel_config["assume_aligned"],
+            strip
+        );
+
+        pair<string, uint64_t> source = codegen_cache.get(block_list, symbols);
+        if (source.first.empty()) {
+            // NB: since the specialized kernels hard-code constants, a kernel that is called with a new constant
+            //     every time would otherwise generate a new kernel every time
+            uint64_t &num_variants = _tier_variants[generic.second];
+            if (num_variants >= tier_max_variants) {
+                return false;
+            }
+            ++num_variants;
+
+            const auto tcodegen = chrono::steady_clock::now();
+            stringstream ss;
+            writeKernel(block_list, symbols, kernel_temps, source.second, ss);
+            source.first = ss.str();
+            stat.time_codegen += chrono::steady_clock::now() - tcodegen;
+            codegen_cache.insert(source.first, block_list, symbols);
         }
+        return executeSpecialized(source.first, source.second, symbols.getParams(), generic.first,
+                                  kernelWork(block_list));
     }
 };
 
@@ -23,6 +23,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 
 #include <jitk/block.hpp>
+#include <jitk/cost_model.hpp>
 #include <bh_config_parser.hpp>
 #include <bh_instruction.hpp>
 
@@ -52,9 +53,14 @@ void fuser_breadth_first(std::vector<Block> &block_list, bool avoid_rank0_sweep)
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
 void fuser_reshapable_first(std::vector<Block> &block_list, bool avoid_rank0_sweep);
 
-// Fuses 'block_list' greedily
+// Fuses 'block_list' greedily prioritized by 'cost_model'
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
-void fuser_greedy(const ConfigParser &config, std::vector<Block> &block_list, bool avoid_rank0_sweep);
+void fuser_greedy(const ConfigParser &config, const CostModel &cost_model, std::vector<Block> &block_list,
+                  bool avoid_rank0_sweep);
+
+// Fuses independent blocks in 'block_list' that read the same arrays (horizontal fusion) prioritized by 'cost_model'
+// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+void fuser_sibling(const CostModel &cost_model, std::vector<Block> &block_list, bool avoid_rank0_sweep);
 
 } // jit
 } // bohrium
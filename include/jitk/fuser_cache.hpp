@@ -21,6 +21,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <map>
 #include <vector>
+#include <boost/filesystem/path.hpp>
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
@@ -33,6 +34,16 @@ namespace jitk {
 class FuseCache {
 private:
     std::map<size_t, std::vector<Block> > _cache;
+
+    // Directory where cache entries persist between executions (empty means disabled)
+    boost::filesystem::path _persist_dir;
+    // Hash of the configuration that the persistent cache entries must match
+    uint64_t _persist_hash = 0;
+
+    // Load the cache entry `lookup_hash` from the persistent cache into `_cache`. Returns true on success.
+    bool load(size_t lookup_hash);
+    // Write the cache entry `lookup_hash` to the persistent cache
+    void store(size_t lookup_hash, const std::vector<Block> &block_list) const;
 public:
     // Some statistics
     jitk::Statistics &stat;
@@ -40,6 +51,13 @@ public:
     // The constructor takes the statistic object
     FuseCache(jitk::Statistics &stat) : stat(stat) {}
 
+    // Let the cache persist between executions by storing it in `dir`.
+    // `config_hash` should identify the configuration of the fuser.
+    void setPersistentDir(const boost::filesystem::path &dir, uint64_t config_hash) {
+        _persist_dir = dir;
+        _persist_hash = config_hash;
+    }
+
     // Check the cache for a block list that matches 'instr_list'
     std::pair<std::vector<Block>, bool> get(const std::vector<bh_instruction *> &instr_list);
     // Insert 'block_list' as a hit when requesting 'instr_list'
@@ -24,6 +24,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 
 #include <jitk/block.hpp>
+#include <jitk/cost_model.hpp>
 #include <bh_instruction.hpp>
 
 #include <boost/graph/graph_traits.hpp>
@@ -133,9 +134,21 @@ std::vector<Block> topological(DAG &dag, bool avoid_rank0_sweep) {
     return ret;
 }
 
-// Merges the vertices in 'dag' greedily.
-// 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
-void greedy(DAG &dag, bool avoid_rank0_sweep);
+/* Merges the vertices in 'dag' greedily by always merging the edge with the greatest benefit according
+ * to 'cost_model'. Returns the merged blocks in topological order.
+ * 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+ *
+ * Complexity: O(M * (D + log E)) where M is the number of merges and D is the search for a path between
+ *             two vertices, which is bounded by their distance in the topological order
+ */
+std::vector<Block> greedy(const DAG &dag, const CostModel &cost_model, bool avoid_rank0_sweep);
+
+/* Merges independent vertices in 'dag' (i.e. no path between them) that read the same non-temporary arrays.
+ * The pairs with the greatest benefit according to 'cost_model' are merged first.
+ * Returns the blocks in topological order.
+ * 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
+ */
+std::vector<Block> sibling(const DAG &dag, const CostModel &cost_model, bool avoid_rank0_sweep);
 
 } // graph
 } // jit
@@ -33,6 +33,14 @@ namespace jitk {
 // Write the source code of an instruction (set 'opencl' for OpenCL specific output)
 void write_instr(const Scope &scope, const bh_instruction &instr, std::stringstream &out, bool opencl = false);
 
+// Return true when 'opcode' is supported by `write_simd_operation()`
+bool has_simd_operation(bh_opcode opcode);
+
+// Write the vector expression of 'instr' where 'ops' are the vectors of the operands and 'type' is the element type.
+// The expression uses the vector types and math functions of `kernel_dependencies/simd_math_openmp.h`.
+void write_simd_operation(const bh_instruction &instr, const std::vector<std::string> &ops, const std::string &type,
+                          std::stringstream &out);
+
 // Return true when 'opcode' has a neutral initial reduction value
 bool has_reduce_identity(bh_opcode opcode);
 
@@ -0,0 +1,347 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* This is the vector math library of the explicit SIMD loops (see `simd_openmp.h`), which implements
+ * the transcendental functions using only vector arithmetic, thus without calling libm per element.
+ * exp() and log() are accurate to 1.5 ULP or, when `BH_SIMD_MATH_FAST` is defined, to 3.5 ULP using
+ * shorter polynomials. sin(), cos(), and tanh() are accurate to 3 ULP.
+ *
+ * The functions reduce the argument to a small range where a polynomial approximates the function:
+ *   - exp(x) = 2^n * exp(r) where x = n*ln(2) + r and |r| <= ln(2)/2
+ *   - log(x) = e*ln(2) + log(m) where x = m * 2^e and sqrt(1/2) <= m < sqrt(2)
+ *   - sin(x) and cos(x) = +-sin(r) or +-cos(r) where x = n*pi/2 + r and |r| <= pi/4
+ *   - tanh(x) = expm1(2x) / (expm1(2x) + 2)
+ * Arguments of sin() and cos() too large for the vector range reduction are computed by libm.
+ */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <kernel_dependencies/simd_openmp.h>
+
+#ifdef BH_SIMD_MATH_FAST
+    #define BH_SIMD_MATH_FAST_POLY 1
+#else
+    #define BH_SIMD_MATH_FAST_POLY 0
+#endif
+
+// Element-wise selection: `m ? a : b` where `m` is the result of a vector comparison
+static inline bh_simd_double bh_simd_select_double(bh_simd_mask_double m, bh_simd_double a, bh_simd_double b) {
+    return (bh_simd_double) ((m & (bh_simd_mask_double) a) | (~m & (bh_simd_mask_double) b));
+}
+static inline bh_simd_float bh_simd_select_float(bh_simd_mask_float m, bh_simd_float a, bh_simd_float b) {
+    return (bh_simd_float) ((m & (bh_simd_mask_float) a) | (~m & (bh_simd_mask_float) b));
+}
+
+// Returns true when any element of `m` is true
+static inline int bh_simd_any_double(bh_simd_mask_double m) {
+    int64_t ret = 0;
+    for (int i = 0; i < BH_SIMD_LEN_double; ++i) { ret |= m[i]; }
+    return ret != 0;
+}
+static inline int bh_simd_any_float(bh_simd_mask_float m) {
+    int32_t ret = 0;
+    for (int i = 0; i < BH_SIMD_LEN_float; ++i) { ret |= m[i]; }
+    return ret != 0;
+}
+
+// Rounds `x` to the nearest integer and writes the integer to `*n` (|x| must be less than 2^51 and 2^22)
+static inline bh_simd_double bh_simd_round_double(bh_simd_double x, bh_simd_mask_double *n) {
+    const bh_simd_double t = x + 0x1.8p52;
+    *n = (bh_simd_mask_double) t - (bh_simd_mask_double) bh_simd_set1_double(0x1.8p52);
+    return t - 0x1.8p52;
+}
+static inline bh_simd_float bh_simd_round_float(bh_simd_float x, bh_simd_mask_float *n) {
+    const bh_simd_float t = x + 0x1.8p23f;
+    *n = (bh_simd_mask_float) t - (bh_simd_mask_float) bh_simd_set1_float(0x1.8p23f);
+    return t - 0x1.8p23f;
+}
+
+// Returns 2^n where `n` must be a normal exponent
+static inline bh_simd_double bh_simd_pow2i_double(bh_simd_mask_double n) {
+    return (bh_simd_double) ((n + 1023) << 52);
+}
+static inline bh_simd_float bh_simd_pow2i_float(bh_simd_mask_float n) {
+    return (bh_simd_float) ((n + 127) << 23);
+}
+
+// Returns expm1(r) for |r| <= ln(2)/2 using its Taylor series, which is one term shorter when `fast` is set
+static inline bh_simd_double bh_simd_expm1_poly_double(bh_simd_double r, int fast) {
+    bh_simd_double p;
+    if (fast) {
+        p = r * (1.0/479001600) + 1.0/39916800;
+    } else {
+        p = r * (1.0/6227020800) + 1.0/479001600;
+        p = p * r + 1.0/39916800;
+    }
+    p = p * r + 1.0/3628800;
+    p = p * r + 1.0/362880;
+    p = p * r + 1.0/40320;
+    p = p * r + 1.0/5040;
+    p = p * r + 1.0/720;
+    p = p * r + 1.0/120;
+    p = p * r + 1.0/24;
+    p = p * r + 1.0/6;
+    p = p * r + 0.5;
+    return r + r * r * p;
+}
+static inline bh_simd_float bh_simd_expm1_poly_float(bh_simd_float r, int fast) {
+    bh_simd_float p;
+    if (fast) {
+        p = r * (1.0f/720) + 1.0f/120;
+    } else {
+        p = r * (1.0f/5040) + 1.0f/720;
+        p = p * r + 1.0f/120;
+    }
+    p = p * r + 1.0f/24;
+    p = p * r + 1.0f/6;
+    p = p * r + 0.5f;
+    return r + r * r * p;
+}
+
+// Splits `x` into `n*ln(2) + r` and returns `r`
+static inline bh_simd_double bh_simd_exp_reduce_double(bh_simd_double x, bh_simd_mask_double *n) {
+    const bh_simd_double fn = bh_simd_round_double(x * 1.4426950408889634, n);
+    return (x - fn * 6.93147180369123816490e-01) - fn * 1.90821492927058770002e-10;
+}
+static inline bh_simd_float bh_simd_exp_reduce_float(bh_simd_float x, bh_simd_mask_float *n) {
+    const bh_simd_float fn = bh_simd_round_float(x * 1.44269504f, n);
+    return (x - fn * 0.693359375f) - fn * -2.12194440e-4f;
+}
+
+static inline bh_simd_double bh_simd_exp_double(bh_simd_double x) {
+    bh_simd_mask_double n;
+    const bh_simd_double r = bh_simd_exp_reduce_double(x, &n);
+    // NB: 2^n is applied in two steps since it isn't a normal number at the ends of the range
+    const bh_simd_mask_double n1 = n >> 1;
+    bh_simd_double ret = (bh_simd_expm1_poly_double(r, BH_SIMD_MATH_FAST_POLY) + 1.0) * bh_simd_pow2i_double(n1);
+    ret = ret * bh_simd_pow2i_double(n - n1);
+    ret = bh_simd_select_double(x > 709.782712893384, bh_simd_set1_double(INFINITY), ret);
+    return bh_simd_select_double(x < -745.1332191019411, bh_simd_set1_double(0), ret);
+}
+static inline bh_simd_float bh_simd_exp_float(bh_simd_float x) {
+    bh_simd_mask_float n;
+    const bh_simd_float r = bh_simd_exp_reduce_float(x, &n);
+    const bh_simd_mask_float n1 = n >> 1;
+    bh_simd_float ret = (bh_simd_expm1_poly_float(r, BH_SIMD_MATH_FAST_POLY) + 1.0f) * bh_simd_pow2i_float(n1);
+    ret = ret * bh_simd_pow2i_float(n - n1);
+    ret = bh_simd_select_float(x > 88.72283905206835f, bh_simd_set1_float(INFINITY), ret);
+    return bh_simd_select_float(x < -103.97208f, bh_simd_set1_float(0), ret);
+}
+
+// Returns log(1+f) for sqrt(1/2)-1 <= f < sqrt(2)-1 using the series of 2*atanh(s) where s = f/(2+f)
+static inline bh_simd_double bh_simd_log1p_poly_double(bh_simd_double f) {
+    const bh_simd_double s = f / (f + 2.0);
+    const bh_simd_double z = s * s;
+    bh_simd_double p;
+    if (BH_SIMD_MATH_FAST_POLY) {
+        p = z * (2.0/19) + 2.0/17;
+    } else {
+        p = z * (2.0/21) + 2.0/19;
+        p = p * z + 2.0/17;
+    }
+    p = p * z + 2.0/15;
+    p = p * z + 2.0/13;
+    p = p * z + 2.0/11;
+    p = p * z + 2.0/9;
+    p = p * z + 2.0/7;
+    p = p * z + 2.0/5;
+    p = p * z + 2.0/3;
+    // log(1+f) = f - (f*f/2 - s*(f*f/2 + z*p)), which avoids rounding errors in the leading term
+    const bh_simd_double hfsq = 0.5 * f * f;
+    return f - (hfsq - s * (hfsq + z * p));
+}
+static inline bh_simd_float bh_simd_log1p_poly_float(bh_simd_float f) {
+    const bh_simd_float s = f / (f + 2.0f);
+    const bh_simd_float z = s * s;
+    bh_simd_float p;
+    if (BH_SIMD_MATH_FAST_POLY) {
+        p = z * (2.0f/7) + 2.0f/5;
+    } else {
+        p = z * (2.0f/9) + 2.0f/7;
+        p = p * z + 2.0f/5;
+    }
+    p = p * z + 2.0f/3;
+    const bh_simd_float hfsq = 0.5f * f * f;
+    return f - (hfsq - s * (hfsq + z * p));
+}
+
+static inline bh_simd_double bh_simd_log_double(bh_simd_double x) {
+    // Subnormals are scaled into the normal range
+    const bh_simd_mask_double subnormal = x < 0x1p-1022;
+    const bh_simd_double y = bh_simd_select_double(subnormal, x * 0x1p54, x);
+    const bh_simd_mask_double bits = (bh_simd_mask_double) y;
+    bh_simd_mask_double e = ((bits >> 52) & 0x7ff) - 1023 + (subnormal & -54);
+    bh_simd_double m = (bh_simd_double) ((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    const bh_simd_mask_double big = m > 1.4142135623730951;
+    m = bh_simd_select_double(big, m * 0.5, m);
+    e = e - big; // NB: true is -1
+    const bh_simd_double fe = (bh_simd_double) (e + (bh_simd_mask_double) bh_simd_set1_double(0x1.8p52)) - 0x1.8p52;
+    bh_simd_double ret = fe * 6.93147180369123816490e-01 + (bh_simd_log1p_poly_double(m - 1.0) +
+                                                             fe * 1.90821492927058770002e-10);
+    // Special cases: log(+inf) = +inf, log(0) = -inf, log(x < 0) = nan, and log(nan) = nan
+    ret = bh_simd_select_double(x == INFINITY, x, ret);
+    ret = bh_simd_select_double(x == 0, bh_simd_set1_double(-INFINITY), ret);
+    return bh_simd_select_double((x < 0) | (x != x), bh_simd_set1_double(NAN), ret);
+}
+static inline bh_simd_float bh_simd_log_float(bh_simd_float x) {
+    const bh_simd_mask_float subnormal = x < 0x1p-126f;
+    const bh_simd_float y = bh_simd_select_float(subnormal, x * 0x1p25f, x);
+    const bh_simd_mask_float bits = (bh_simd_mask_float) y;
+    bh_simd_mask_float e = ((bits >> 23) & 0xff) - 127 + (subnormal & -25);
+    bh_simd_float m = (bh_simd_float) ((bits & 0x007fffff) | 0x3f800000);
+    const bh_simd_mask_float big = m > 1.41421356f;
+    m = bh_simd_select_float(big, m * 0.5f, m);
+    e = e - big;
+    const bh_simd_float fe = (bh_simd_float) (e + (bh_simd_mask_float) bh_simd_set1_float(0x1.8p23f)) - 0x1.8p23f;
+    bh_simd_float ret = fe * 0.693359375f + (bh_simd_log1p_poly_float(m - 1.0f) + fe * -2.12194440e-4f);
+    ret = bh_simd_select_float(x == INFINITY, x, ret);
+    ret = bh_simd_select_float(x == 0, bh_simd_set1_float(-INFINITY), ret);
+    return bh_simd_select_float((x < 0) | (x != x), bh_simd_set1_float(NAN), ret);
+}
+
+// Returns sin(r) and cos(r) for |r| <= pi/4 using their Taylor series
+static inline bh_simd_double bh_simd_sin_poly_double(bh_simd_double r) {
+    const bh_simd_double z = r * r;
+    bh_simd_double p = z * (-1.0/1307674368000) + 1.0/6227020800;
+    p = p * z - 1.0/39916800;
+    p = p * z + 1.0/362880;
+    p = p * z - 1.0/5040;
+    p = p * z + 1.0/120;
+    p = p * z - 1.0/6;
+    return r + r * z * p;
+}
+static inline bh_simd_double bh_simd_cos_poly_double(bh_simd_double r) {
+    const bh_simd_double z = r * r;
+    bh_simd_double p = z * (-1.0/6402373705728000) + 1.0/20922789888000;
+    p = p * z - 1.0/87178291200;
+    p = p * z + 1.0/479001600;
+    p = p * z - 1.0/3628800;
+    p = p * z + 1.0/40320;
+    p = p * z - 1.0/720;
+    p = p * z + 1.0/24;
+    // NB: the rounding error of `1 - z/2` is added back
+    const bh_simd_double hz = 0.5 * z;
+    const bh_simd_double w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + z * z * p);
+}
+static inline bh_simd_float bh_simd_sin_poly_float(bh_simd_float r) {
+    const bh_simd_float z = r * r;
+    bh_simd_float p = z * (1.0f/362880) - 1.0f/5040;
+    p = p * z + 1.0f/120;
+    p = p * z - 1.0f/6;
+    return r + r * z * p;
+}
+static inline bh_simd_float bh_simd_cos_poly_float(bh_simd_float r) {
+    const bh_simd_float z = r * r;
+    bh_simd_float p = z * (1.0f/40320) - 1.0f/720;
+    p = p * z + 1.0f/24;
+    const bh_simd_float hz = 0.5f * z;
+    const bh_simd_float w = 1.0f - hz;
+    return w + (((1.0f - w) - hz) + z * z * p);
+}
+
+// Returns sin(x) when `quadrant_offset` is 0 and cos(x) when it is 1
+static inline bh_simd_double bh_simd_sincos_double(bh_simd_double x, int64_t quadrant_offset) {
+    bh_simd_mask_double n;
+    const bh_simd_double fn = bh_simd_round_double(x * 0.63661977236758134, &n);
+    const bh_simd_double r = ((x - fn * 1.57079632673412561417e+00) - fn * 6.07710050630396597660e-11)
+                             - fn * 2.02226624871116645580e-21;
+    const bh_simd_mask_double q = n + quadrant_offset;
+    bh_simd_double ret = bh_simd_select_double((q & 1) != 0, bh_simd_cos_poly_double(r), bh_simd_sin_poly_double(r));
+    ret = (bh_simd_double) ((bh_simd_mask_double) ret ^ ((q & 2) << 62));
+
+    // Large arguments need a more precise range reduction, which we leave to libm
+    const bh_simd_mask_double large = (x > 1e5) | (x < -1e5);
+    if (bh_simd_any_double(large)) {
+        for (int i = 0; i < BH_SIMD_LEN_double; ++i) {
+            if (large[i]) {
+                ret[i] = quadrant_offset == 0 ? sin(x[i]) : cos(x[i]);
+            }
+        }
+    }
+    return ret;
+}
+static inline bh_simd_float bh_simd_sincos_float(bh_simd_float x, int32_t quadrant_offset) {
+    bh_simd_mask_float n;
+    const bh_simd_float fn = bh_simd_round_float(x * 0.636619772f, &n);
+    // NB: pi/2 is split into parts of 12 bits, which makes the products with `fn` exact
+    bh_simd_float r = x - fn * 0x1.922p+0f;
+    r = r - fn * -0x1.2aep-18f;
+    r = r - fn * -0x1.deap-31f;
+    r = r - fn * 0x1.184p-44f;
+    r = r - fn * 0x1.a62p-58f;
+    const bh_simd_mask_float q = n + quadrant_offset;
+    bh_simd_float ret = bh_simd_select_float((q & 1) != 0, bh_simd_cos_poly_float(r), bh_simd_sin_poly_float(r));
+    ret = (bh_simd_float) ((bh_simd_mask_float) ret ^ ((q & 2) << 30));
+    const bh_simd_mask_float large = (x > 4096.0f) | (x < -4096.0f);
+    if (bh_simd_any_float(large)) {
+        for (int i = 0; i < BH_SIMD_LEN_float; ++i) {
+            if (large[i]) {
+                ret[i] = quadrant_offset == 0 ? sinf(x[i]) : cosf(x[i]);
+            }
+        }
+    }
+    return ret;
+}
+
+static inline bh_simd_double bh_simd_sin_double(bh_simd_double x) { return bh_simd_sincos_double(x, 0); }
+static inline bh_simd_double bh_simd_cos_double(bh_simd_double x) { return bh_simd_sincos_double(x, 1); }
+static inline bh_simd_float bh_simd_sin_float(bh_simd_float x) { return bh_simd_sincos_float(x, 0); }
+static inline bh_simd_float bh_simd_cos_float(bh_simd_float x) { return bh_simd_sincos_float(x, 1); }
+
+// Returns expm1(x) for |x| <= 44 (double) and |x| <= 18 (float): 2^n * (expm1(r) + 1) - 1, which is exact when n = 0
+static inline bh_simd_double bh_simd_expm1_small_double(bh_simd_double x) {
+    bh_simd_mask_double n;
+    const bh_simd_double r = bh_simd_exp_reduce_double(x, &n);
+    const bh_simd_double scale = bh_simd_pow2i_double(n);
+    return bh_simd_expm1_poly_double(r, 0) * scale + (scale - 1.0);
+}
+static inline bh_simd_float bh_simd_expm1_small_float(bh_simd_float x) {
+    bh_simd_mask_float n;
+    const bh_simd_float r = bh_simd_exp_reduce_float(x, &n);
+    const bh_simd_float scale = bh_simd_pow2i_float(n);
+    return bh_simd_expm1_poly_float(r, 0) * scale + (scale - 1.0f);
+}
+
+// tanh(|x|) = -t/(t+2) where t = expm1(-2|x|) when |x| < 1 and 1 - 2/(expm1(2|x|)+2) otherwise
+static inline bh_simd_double bh_simd_tanh_double(bh_simd_double x) {
+    const bh_simd_mask_double sign = (bh_simd_mask_double) x & (bh_simd_mask_double) bh_simd_set1_double(-0.0);
+    const bh_simd_double ax = (bh_simd_double) ((bh_simd_mask_double) x ^ sign);
+    const bh_simd_mask_double small = ax < 1.0;
+    const bh_simd_double t = bh_simd_expm1_small_double(bh_simd_select_double(small, -2.0 * ax,
+                                                         bh_simd_select_double(ax > 22.0, bh_simd_set1_double(44), 2.0 * ax)));
+    bh_simd_double ret = bh_simd_select_double(small, -t / (t + 2.0), 1.0 - 2.0 / (t + 2.0));
+    ret = bh_simd_select_double(ax > 22.0, bh_simd_set1_double(1), ret);
+    // NB: -t/(t+2) is -0.0 when x is +0.0, thus we clear the sign bit of `ret` before copying the sign of `x`
+    const bh_simd_mask_double signbit = (bh_simd_mask_double) bh_simd_set1_double(-0.0);
+    return (bh_simd_double) (((bh_simd_mask_double) ret & ~signbit) | sign);
+}
+static inline bh_simd_float bh_simd_tanh_float(bh_simd_float x) {
+    const bh_simd_mask_float sign = (bh_simd_mask_float) x & (bh_simd_mask_float) bh_simd_set1_float(-0.0f);
+    const bh_simd_float ax = (bh_simd_float) ((bh_simd_mask_float) x ^ sign);
+    const bh_simd_mask_float small = ax < 1.0f;
+    const bh_simd_float t = bh_simd_expm1_small_float(bh_simd_select_float(small, -2.0f * ax,
+                                                      bh_simd_select_float(ax > 9.0f, bh_simd_set1_float(18), 2.0f * ax)));
+    bh_simd_float ret = bh_simd_select_float(small, -t / (t + 2.0f), 1.0f - 2.0f / (t + 2.0f));
+    ret = bh_simd_select_float(ax > 9.0f, bh_simd_set1_float(1), ret);
+    const bh_simd_mask_float signbit = (bh_simd_mask_float) bh_simd_set1_float(-0.0f);
+    return (bh_simd_float) (((bh_simd_mask_float) ret & ~signbit) | sign);
+}
@@ -0,0 +1,77 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// This is the explicit SIMD interface of the C99/OpenMP kernels, which uses the GCC/Clang vector extensions.
+// The vector size is selected from the ISA that the kernel is compiled for (e.g. `-march=native`).
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX512F__)
+    #define BH_SIMD_BYTES 64
+#elif defined(__AVX__)
+    #define BH_SIMD_BYTES 32
+#else
+    #define BH_SIMD_BYTES 16 // SSE2, NEON, etc.
+#endif
+
+typedef float bh_simd_float __attribute__((vector_size(BH_SIMD_BYTES)));
+typedef double bh_simd_double __attribute__((vector_size(BH_SIMD_BYTES)));
+
+// The results of vector comparisons, which are -1 (true) and 0 (false) of the same size as the elements
+typedef int32_t bh_simd_mask_float __attribute__((vector_size(BH_SIMD_BYTES)));
+typedef int64_t bh_simd_mask_double __attribute__((vector_size(BH_SIMD_BYTES)));
+
+// Number of elements in a vector
+#define BH_SIMD_LEN_float (BH_SIMD_BYTES / 4)
+#define BH_SIMD_LEN_double (BH_SIMD_BYTES / 8)
+
+// Loads, stores, broadcasts, and horizontal reductions of each type.
+// NB: the loads and stores are unaligned since the views can start anywhere in the base array
+#define BH_SIMD_FUNCTIONS(T)                                                                                  \
+static inline bh_simd_##T bh_simd_load_##T(const T *p) { bh_simd_##T v; memcpy(&v, p, sizeof(v)); return v; } \
+static inline void bh_simd_store_##T(T *p, bh_simd_##T v) { memcpy(p, &v, sizeof(v)); }                      \
+static inline bh_simd_##T bh_simd_set1_##T(T x) {                                                            \
+    bh_simd_##T v;                                                                                            \
+    for (int i = 0; i < BH_SIMD_LEN_##T; ++i) { v[i] = x; }                                                   \
+    return v;                                                                                                 \
+}                                                                                                             \
+static inline T bh_simd_hsum_##T(bh_simd_##T v) {                                                             \
+    T ret = 0;                                                                                                \
+    for (int i = 0; i < BH_SIMD_LEN_##T; ++i) { ret += v[i]; }                                                \
+    return ret;                                                                                               \
+}                                                                                                             \
+static inline T bh_simd_hprod_##T(bh_simd_##T v) {                                                            \
+    T ret = 1;                                                                                                \
+    for (int i = 0; i < BH_SIMD_LEN_##T; ++i) { ret *= v[i]; }                                                \
+    return ret;                                                                                               \
+}
+
+BH_SIMD_FUNCTIONS(float)
+BH_SIMD_FUNCTIONS(double)
+
+// The reductions of vectors across the OpenMP threads
+#ifdef _OPENMP
+#pragma omp declare reduction(bh_simd_add: bh_simd_float: omp_out += omp_in) initializer(omp_priv = bh_simd_set1_float(0))
+#pragma omp declare reduction(bh_simd_mul: bh_simd_float: omp_out *= omp_in) initializer(omp_priv = bh_simd_set1_float(1))
+#pragma omp declare reduction(bh_simd_add: bh_simd_double: omp_out += omp_in) initializer(omp_priv = bh_simd_set1_double(0))
+#pragma omp declare reduction(bh_simd_mul: bh_simd_double: omp_out *= omp_in) initializer(omp_priv = bh_simd_set1_double(1))
+#endif
@@ -0,0 +1,82 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <vector>
+
+#include <bh_base.hpp>
+#include <jitk/statistics.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+/* Assignment of the arrays that live within a flush to physical buffers, which works like a register allocator:
+ * an array that is first accessed and freed within the flush gets the buffer of an array freed earlier in the flush
+ * when the sizes are similar, thus the new array neither maps new memory nor faults its pages in again.
+ * The flush is a sequence of steps (the kernel launches) and the arrays are referenced by IDs.
+ */
+class MemoryPlan {
+public:
+    // The buffer that array `array` gets at the beginning of a step
+    struct Assignment {
+        size_t array;
+        size_t buffer;
+    };
+    // The size in bytes of each buffer
+    std::vector<uint64_t> capacities;
+    // The assignments of each step
+    std::vector<std::vector<Assignment> > steps;
+
+    MemoryPlan() = default;
+
+    // Plan the buffers of a flush where `sizes` is the size in bytes of each array, `accesses[i]` is the arrays
+    // accessed by step `i`, and `frees[i]` is the arrays freed after step `i`
+    MemoryPlan(const std::vector<uint64_t> &sizes,
+               const std::vector<std::vector<size_t> > &accesses,
+               const std::vector<std::vector<size_t> > &frees);
+
+    /* The buffers of a plan while its flush executes. A buffer is mapped when it is first needed and returned to the
+     * memory pool (see `bh_memory_free()`) when the execution is destructed.
+     */
+    class Execution {
+    private:
+        const MemoryPlan &_plan;
+        Statistics &_stat;
+        // The memory of each buffer or NULL when not mapped yet
+        std::vector<void*> _buffers;
+        // The bytes of the arrays that got a buffer, which is the memory they would allocate without the plan,
+        // and the bytes of the mapped buffers
+        uint64_t _unplanned = 0;
+        uint64_t _mapped = 0;
+    public:
+        Execution(const MemoryPlan &plan, Statistics &stat) : _plan(plan), _stat(stat),
+                                                              _buffers(plan.capacities.size(), nullptr) {}
+        ~Execution();
+
+        // Hand the buffers of step `step` to its arrays that are unallocated, where `arrays` maps IDs to arrays
+        void assign(size_t step, const std::vector<bh_base*> &arrays);
+
+        // Free `base`, which returns its buffer to the plan or frees its memory like `bh_data_free()`
+        void free(bh_base *base);
+    };
+};
+
+} // jitk
+} // bohrium
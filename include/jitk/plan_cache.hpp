@@ -0,0 +1,132 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <bh_ir.hpp>
+#include <bh_constant.hpp>
+#include <jitk/statistics.hpp>
+#include <jitk/memory_plan.hpp>
+#include <jitk/thread_pool.hpp>
+
+
+namespace bohrium {
+namespace jitk {
+
+// The launcher function of a CPU kernel, which executes its parallel loops using `parallel_for` on `pool`
+// when the kernel is written for the thread pool runtime (see `thread_pool`) and otherwise using
+// `num_threads` OpenMP threads
+typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[],
+                               void *pool, ThreadPool::ParallelFor parallel_for, int num_threads);
+
+// A kernel launch within an execution plan.
+// Base arrays are referenced by their index in `PlanCache::key()` and instructions by their index in the BhIR.
+struct PlanKernel {
+    KernelFunction func;
+    // The arrays passed to the kernel
+    std::vector<size_t> params;
+    // The offset-and-strides followed by the extents, which are fixed by the structure of the BhIR
+    std::vector<uint64_t> offset_strides;
+    // The instructions that hold the constants passed to the kernel
+    std::vector<size_t> constants;
+    // The arrays to free after the kernel
+    std::vector<size_t> frees;
+    // The number of iterations of the kernel (see `EngineCPU::kernelWork()`)
+    uint64_t work;
+    // The name of the kernel in `Statistics::time_per_kernel` and whether it is a specialized kernel (tiered JIT)
+    std::string kernel_name;
+    bool tier1;
+    // Whether the kernel is a generic kernel that becomes specialized when hot, which invalidates the plan
+    bool may_tier_up;
+};
+
+// The execution plan of a BhIR: the kernel launches and frees that the execution of the BhIR resolves to
+struct ExecutionPlan {
+    // The arrays to free before the first kernel
+    std::vector<size_t> frees;
+    std::vector<PlanKernel> kernels;
+    // The constants hard-coded in the kernels, which must match the BhIR for the plan to apply
+    std::vector<std::pair<size_t, bh_constant> > guards;
+    // The arrays that the kernels assume are aligned (see `assume_aligned`), which must be aligned or unallocated
+    // for the plan to apply
+    std::vector<size_t> aligned;
+    // The buffers of the arrays that live within the BhIR, where the steps are the kernels
+    MemoryPlan memory;
+    // The work of the kernels that are below the parallel threshold (see `Statistics::threading_below_threshold`)
+    uint64_t work_below_threshold = 0;
+};
+
+/* Cache of execution plans, which makes it possible to execute a BhIR without fusion, codegen, and kernel lookups
+ * when a BhIR with the same structure has been executed before.
+ * The cache holds at most `max_plans` plans and evicts the least recently used plan when full.
+ */
+class PlanCache {
+private:
+    typedef std::list<std::vector<uint64_t> > LruList;
+    struct Entry {
+        ExecutionPlan plan;
+        // The position of the key in `_lru`
+        LruList::iterator lru;
+    };
+    std::map<std::vector<uint64_t>, Entry> _cache;
+    // The keys of `_cache` ordered from the most to the least recently used
+    LruList _lru;
+    // The maximum number of plans (0 means no limit)
+    const uint64_t _max_plans;
+public:
+    // Some statistics
+    jitk::Statistics &stat;
+
+    // The constructor takes the statistic object and the maximum number of plans (0 means no limit)
+    PlanCache(jitk::Statistics &stat, uint64_t max_plans = 0) : _max_plans(max_plans), stat(stat) {}
+
+    // Returns the structure of `bhir`, which is everything but the base array pointers and the constant values.
+    // `bases` is set to the base arrays of `bhir` in the order they appear.
+    static std::vector<uint64_t> key(const BhIR &bhir, std::vector<bh_base*> &bases);
+
+    // Returns the plan of `lookup_key` or nullptr when the plan doesn't exist or its guards doesn't match `bhir`
+    // and `bases`, which are the base arrays found by `key()`
+    ExecutionPlan *get(const std::vector<uint64_t> &lookup_key, const BhIR &bhir, const std::vector<bh_base*> &bases);
+
+    // Insert `plan` as the plan of `lookup_key`, which is the key of `bhir` and `bases`.
+    // The frees, guards, and memory plan of `plan` are derived from `bhir`.
+    void insert(const std::vector<uint64_t> &lookup_key, const BhIR &bhir, const std::vector<bh_base*> &bases, ExecutionPlan plan);
+
+    // Remove the plan of `lookup_key`, e.g. when the plan is outdated
+    void erase(const std::vector<uint64_t> &lookup_key) {
+        auto lookup = _cache.find(lookup_key);
+        if (lookup != _cache.end()) {
+            _lru.erase(lookup->second.lru);
+            _cache.erase(lookup);
+        }
+    }
+
+    // Returns the number of plans in the cache
+    size_t size() const {
+        return _cache.size();
+    }
+};
+
+} // jit
+} // bohrium
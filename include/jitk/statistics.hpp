@@ -19,6 +19,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <string>
 #include <ostream>
@@ -30,6 +31,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <colors.hpp>
 #include <bh_ir.hpp>
 #include <bh_instruction.hpp>
+#include <bh_memory.h>
 #include <jitk/base_db.hpp>
 #include <bh_config_parser.hpp>
 
@@ -56,12 +58,38 @@ struct KernelStats {
     return this->total_time.count() < rhs.total_time.count();
   }
 
+  // Calls to the specialized version of the kernel (tiered JIT)
+  uint64_t num_calls_tier1 = 0;
+  std::chrono::duration<double> total_time_tier1{0};
+
   void register_exec_time(const std::chrono::duration<double>& exec_time) {
     ++num_calls;
     total_time += exec_time;
     max_time = max(max_time, exec_time);
     min_time = min(min_time, exec_time);
   }
+
+  void register_exec_time_tier1(const std::chrono::duration<double>& exec_time) {
+    ++num_calls_tier1;
+    total_time_tier1 += exec_time;
+  }
+
+  // The estimated execution time of one iteration using one thread, which is a moving average of the execution
+  // times divided by the iterations and multiplied by the number of threads of each launch (i.e. assuming a linear
+  // speedup). Thus, launches of the kernel with different loop sizes share the estimate.
+  double iteration_time = 0;
+
+  void register_iteration_time(double time) {
+    iteration_time = iteration_time == 0 ? time : (iteration_time + time) / 2;
+  }
+
+  // Average time of the generic and the specialized kernel
+  double avg_time() const {
+    return num_calls == 0 ? 0 : total_time.count() / num_calls;
+  }
+  double avg_time_tier1() const {
+    return num_calls_tier1 == 0 ? 0 : total_time_tier1.count() / num_calls_tier1;
+  }
 };
 
 class Statistics {
@@ -69,18 +97,27 @@ class Statistics {
     bool enabled;
     bool print_on_exit; // On exist, write to file or pprint to stdout
     bool verbose; // Print per-kernel statistics
+    uint64_t parallel_threshold; // The loop nests with fewer iterations are serial (zero when not applicable)
     uint64_t num_base_arrays           = 0;
     uint64_t num_temp_arrays           = 0;
     uint64_t num_syncs                 = 0;
     uint64_t max_memory_usage          = 0;
     uint64_t totalwork                 = 0;
     uint64_t threading_below_threshold = 0;
+    uint64_t numa_sampled_pages        = 0;
+    uint64_t numa_remote_pages         = 0;
+    uint64_t mem_plan_arrays           = 0;
+    uint64_t mem_plan_reuses           = 0;
+    uint64_t mem_plan_unplanned        = 0;
+    uint64_t mem_plan_peak_buffers     = 0;
     uint64_t fuser_cache_lookups       = 0;
     uint64_t fuser_cache_misses        = 0;
     uint64_t codegen_cache_lookups     = 0;
     uint64_t codegen_cache_misses      = 0;
     uint64_t kernel_cache_lookups      = 0;
     uint64_t kernel_cache_misses       = 0;
+    uint64_t plan_cache_lookups        = 0;
+    uint64_t plan_cache_misses         = 0;
     uint64_t num_instrs_into_fuser     = 0;
     uint64_t num_blocks_out_of_fuser   = 0;
     std::chrono::duration<double> time_total_execution{0};
@@ -88,6 +125,7 @@ class Statistics {
     std::chrono::duration<double> time_fusion{0};
     std::chrono::duration<double> time_codegen{0};
     std::chrono::duration<double> time_compile{0};
+    std::chrono::duration<double> time_compile_hidden{0}; // Background compile time that didn't stall execution
     std::chrono::duration<double> time_exec{0};
     std::chrono::duration<double> time_offload{0};
     std::chrono::duration<double> time_copy2dev{0};
@@ -102,10 +140,12 @@ class Statistics {
 
     Statistics(const ConfigParser &config) : enabled(config.defaultGet("prof", false)),
                                              print_on_exit(config.defaultGet("prof", false)),
-                                             verbose(config.defaultGet("verbose", false)) {}
+                                             verbose(config.defaultGet("verbose", false)),
+                                             parallel_threshold(config.defaultGet<uint64_t>("parallel_threshold", 0)) {}
     Statistics(bool enabled, const ConfigParser &config) : enabled(enabled),
                                                            print_on_exit(config.defaultGet("prof", false)),
-                                                           verbose(config.defaultGet("verbose", false)) {}
+                                                           verbose(config.defaultGet("verbose", false)),
+                                                           parallel_threshold(config.defaultGet<uint64_t>("parallel_threshold", 0)) {}
 
     void write(std::string backend_name, std::string filename, std::ostream &out) {
         if (filename == "") {
@@ -126,14 +166,27 @@ class Statistics {
             out << "Fuse cache hits:                 " << GRN << fuseCacheHits()                     << "\n" << RST;
             out << "Codegen cache hits               " << GRN << codegenCacheHits()                  << "\n" << RST;
             out << "Kernel cache hits                " << GRN << kernelCacheHits()                   << "\n" << RST;
+            out << "Plan cache hits                  " << GRN << planCacheHits()                     << "\n" << RST;
             out << "Array contractions:              " << GRN << arrayContractions()                 << "\n" << RST;
             out << "Outer-fusion ratio:              " << GRN << outerFusionRatio()                  << "\n" << RST;
             out << "\n";
             out << "Max memory usage:                " << GRN << memoryUsage() << " MB"              << "\n" << RST;
+            out << "Memory pool hits:                " << GRN << memPoolHits()                       << "\n" << RST;
+            out << "Memory pool retained (max):      " << GRN << memPoolRetained() << " MB"          << "\n" << RST;
+            out << "Memory spilled to disk (max):    " << GRN << memSpilled() << " MB"               << "\n" << RST;
+            out << "Memory plan reuses:              " << GRN << memPlanReuses()                     << "\n" << RST;
+            out << "Memory plan allocs (unplanned):  " << GRN << memPlanUnplanned() << " MB"         << "\n" << RST;
+            out << "Memory plan peak (planned):      " << GRN << memPlanPeakBuffers() << " MB"       << "\n" << RST;
+            if (numa_sampled_pages > 0) {
+                out << "NUMA remote pages (sampled):     " << GRN << numaRemotePages()                   << "\n" << RST;
+            }
             out << "Syncs to NumPy:                  " << GRN << num_syncs                           << "\n" << RST;
             out << "Total Work:                      " << GRN << totalwork << " operations"          << "\n" << RST;
             out << "Throughput:                      " << GRN << throughput() << "ops"               << "\n" << RST;
-            out << "Work below par-threshold (1000): " << GRN << workBelowThredshold() << "%"        << "\n" << RST;
+            if (parallel_threshold > 0) {
+                out << "Work below par-threshold:        " << GRN << workBelowThredshold() << "% (threshold "
+                    << parallel_threshold << ")"                                                      << "\n" << RST;
+            }
             out << "\n";
             out << "Wall clock:                      " << BLU << wallclock.count() << "s"            << "\n" << RST;
             out << "Total Execution:                 " << BLU << time_total_execution.count() << "s" << "\n" << RST;
@@ -141,6 +194,7 @@ class Statistics {
             out << "  Fusion:                        " << YEL << time_fusion.count() << "s"          << "\n" << RST;
             out << "  Codegen:                       " << YEL << time_codegen.count() << "s"         << "\n" << RST;
             out << "  Compile:                       " << YEL << time_compile.count() << "s"         << "\n" << RST;
+            out << "    Hidden in background:        " << YEL << time_compile_hidden.count() << "s"  << "\n" << RST;
             out << "  Exec:                          " << YEL << time_exec.count() << "s"            << "\n" << RST;
             out << "  Copy2dev:                      " << YEL << time_copy2dev.count() << "s"        << "\n" << RST;
             out << "  Copy2host:                     " << YEL << time_copy2host.count() << "s"       << "\n" << RST;
@@ -157,7 +211,10 @@ class Statistics {
                                        << std::setw(14) << "Calls"
                                        << std::setw(12) << "Total time"
                                        << std::setw(12) << "Max time"
-                                       << std::setw(12) << "Min time"                                << "\n" << RST;
+                                       << std::setw(12) << "Min time"
+                                       << std::setw(12) << "Avg time"
+                                       << std::setw(14) << "Tier-1 calls"
+                                       << std::setw(12) << "Tier-1 avg"                              << "\n" << RST;
               auto cmp = [](std::pair<std::string, KernelStats> const & a, std::pair<std::string, KernelStats> const & b) {
                 // compare map by values (descending)
                 return !(a.second < b.second);
@@ -173,7 +230,10 @@ class Statistics {
                     << std::scientific   << std::setprecision(2)
                                          << std::setw(8) << kernel_data.total_time.count() << "s   "
                                          << std::setw(8) << kernel_data.max_time.count()   << "s   "
-                                         << std::setw(8) << kernel_data.min_time.count()   << "s   " << "\n" << RST;
+                                         << std::setw(8) << kernel_data.min_time.count()   << "s   "
+                                         << std::setw(8) << kernel_data.avg_time()         << "s   "
+                                         << std::setw(10) << kernel_data.num_calls_tier1   << "    "
+                                         << std::setw(8) << kernel_data.avg_time_tier1()   << "s   " << "\n" << RST;
               }
             }
             out << endl;
@@ -198,9 +258,20 @@ class Statistics {
             file << "  fuse_cache_hits: "       << fuseCacheHits()                   << "\n";
             file << "  codegen_cache_hits: "    << codegenCacheHits()                << "\n";
             file << "  kernel_cache_hits: "     << kernelCacheHits()                 << "\n";
+            file << "  plan_cache_hits: "       << planCacheHits()                   << "\n";
             file << "  array_contractions: "    << arrayContractions()               << "\n";
             file << "  outer_fusion_ratio: "    << outerFusionRatio()                << "\n";
             file << "  memory_usage: "          << memoryUsage()                     << "\n"; // mb
+            file << "  mem_pool_hits: "         << bh_memory_pool_stats().hits       << "\n";
+            file << "  mem_pool_misses: "       << bh_memory_pool_stats().misses     << "\n";
+            file << "  mem_pool_retained: "     << memPoolRetained()                 << "\n"; // mb
+            file << "  mem_spilled: "           << memSpilled()                      << "\n"; // mb
+            file << "  mem_plan_arrays: "       << mem_plan_arrays                   << "\n";
+            file << "  mem_plan_reuses: "       << mem_plan_reuses                   << "\n";
+            file << "  mem_plan_unplanned: "    << memPlanUnplanned()                << "\n"; // mb
+            file << "  mem_plan_peak_buffers: " << memPlanPeakBuffers()              << "\n"; // mb
+            file << "  numa_sampled_pages: "    << numa_sampled_pages                << "\n";
+            file << "  numa_remote_pages: "     << numa_remote_pages                 << "\n";
             file << "  syncs: "                 << num_syncs                         << "\n";
             file << "  total_work: "            << totalwork                         << "\n"; // ops
             file << "  throughput: "            << throughput()                      << "\n"; // ops
@@ -211,6 +282,7 @@ class Statistics {
             file << "    pre_fusion: "          << time_pre_fusion.count()           << "\n"; // s
             file << "    fusion: "              << time_fusion.count()               << "\n"; // s
             file << "    compile: "             << time_compile.count()              << "\n"; // s
+            file << "    compile_hidden: "      << time_compile_hidden.count()       << "\n"; // s
             file << "    exec: "                                                     << "\n";
             file << "      total: "             << time_exec.count()                 << "\n"; // s
             if (verbose) {
@@ -222,6 +294,8 @@ class Statistics {
                 file << "            total_time: " << kernel_data.total_time.count() << "\n"; // s
                 file << "            max_time: "   << kernel_data.max_time.count()   << "\n"; // s
                 file << "            min_time: "   << kernel_data.min_time.count()   << "\n"; // s
+                file << "            tier1_num_calls: "  << kernel_data.num_calls_tier1         << "\n";
+                file << "            tier1_total_time: " << kernel_data.total_time_tier1.count() << "\n"; // s
               }
             }
             file << "    copy2dev: "            << time_copy2dev.count()             << "\n"; // s
@@ -246,6 +320,37 @@ class Statistics {
         }
     }
 
+    // Record the work of the blocks in 'block_list' whose loop nests have fewer than 'parallel_threshold'
+    // iterations, which the engine executes serially.
+    // NB: recorded even when disabled since execution plans replay the work of the BhIR they were recorded from
+    void record(const std::vector<Block> &block_list) {
+        if (parallel_threshold == 0) {
+            return;
+        }
+        for (const Block &block: block_list) {
+            if (block.isInstr()) {
+                continue;
+            }
+            // Like the engine, we approximate the iterations of the loop nest by the sizes of its first loops
+            uint64_t work = 1;
+            for (const LoopB *loop: get_first_loop_blocks(block.getLoop())) {
+                work *= static_cast<uint64_t>(std::max(int64_t{1}, loop->size));
+                if (work >= parallel_threshold) {
+                    break;
+                }
+            }
+            if (work >= parallel_threshold) {
+                continue;
+            }
+            for (const InstrPtr &instr: block.getAllInstr()) {
+                if (instr->opcode != BH_IDENTITY and not bh_opcode_is_system(instr->opcode)) {
+                    const std::vector<int64_t> shape = instr->shape();
+                    threading_below_threshold += bh_nelements(shape.size(), &shape[0]);
+                }
+            }
+        }
+    }
+
     // Record statistics based on the 'symbols'
     void record(const SymbolTable& symbols) {
       num_base_arrays += symbols.getNumBaseArrays();
@@ -269,6 +374,10 @@ class Statistics {
         return pprint_ratio(kernel_cache_lookups - kernel_cache_misses, kernel_cache_lookups);
     }
 
+    std::string planCacheHits() {
+        return pprint_ratio(plan_cache_lookups - plan_cache_misses, plan_cache_lookups);
+    }
+
     std::string arrayContractions() {
         return pprint_ratio(num_temp_arrays, num_base_arrays);
     }
@@ -281,6 +390,39 @@ class Statistics {
         return (double) max_memory_usage / 1024.0 / 1024.0;
     }
 
+    // NB: the memory pool is shared by all components in the process
+    std::string memPoolHits() {
+        const bh_memory_pool_stat pool = bh_memory_pool_stats();
+        return pprint_ratio(pool.hits, pool.hits + pool.misses);
+    }
+
+    double memPoolRetained() {
+        return (double) bh_memory_pool_stats().max_retained / 1024.0 / 1024.0;
+    }
+
+    double memSpilled() {
+        return (double) bh_memory_pool_stats().max_spilled / 1024.0 / 1024.0;
+    }
+
+    // The arrays that got a buffer from the memory plan of their flush (see `MemoryPlan`)
+    std::string memPlanReuses() {
+        return pprint_ratio(mem_plan_reuses, mem_plan_arrays);
+    }
+
+    // The memory a flush allocates when each planned array has its own memory versus the peak of the planned buffers
+    double memPlanUnplanned() {
+        return (double) mem_plan_unplanned / 1024.0 / 1024.0;
+    }
+
+    double memPlanPeakBuffers() {
+        return (double) mem_plan_peak_buffers / 1024.0 / 1024.0;
+    }
+
+    // The kernel arrays are sampled after each launch (see `bh_memory_numa_sample()`)
+    std::string numaRemotePages() {
+        return pprint_ratio(numa_remote_pages, numa_sampled_pages);
+    }
+
     double throughput() {
         return (double) totalwork / (double) wallclock.count();
     }
@@ -0,0 +1,103 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace bohrium {
+namespace jitk {
+
+/**
+ * A pool of persistent worker threads that executes the parallel loops of the kernels (see `thread_pool`).
+ * The iterations of a loop are split evenly between the threads, which executes their own share in chunks
+ * and then steal chunks from the other threads. The calling thread participates and waits on the workers
+ * by spinning, thus the end of a parallel loop is a lightweight barrier rather than an OpenMP join.
+ */
+class ThreadPool {
+public:
+    // The body of a parallel loop, which executes the iterations [begin, end)
+    typedef void (*LoopBody)(void *args, uint64_t begin, uint64_t end);
+
+    // The `parallel_for` callback of the kernels, which calls `parallelFor()` on `pool`
+    typedef void (*ParallelFor)(void *pool, LoopBody body, void *args, uint64_t niters);
+    static void parallelFor(void *pool, LoopBody body, void *args, uint64_t niters);
+
+private:
+    // The iterations of a thread, which both the thread and the thieves take chunks from
+    struct alignas(64) Share {
+        std::atomic<uint64_t> next;
+        uint64_t end;
+    };
+    // NB: `new[]` doesn't honor the alignment of `Share` before C++17, thus the shares are allocated by
+    // `posix_memalign()` and freed by this deleter
+    struct FreeShares {
+        void operator()(Share *shares) const;
+    };
+
+    std::vector<std::thread> _workers;
+    std::unique_ptr<Share[], FreeShares> _shares;
+
+    // The loop being executed
+    LoopBody _body = nullptr;
+    void *_args = nullptr;
+    uint64_t _chunk = 1;
+    // The number of threads that executes the loops, which are the threads with the lowest IDs
+    std::atomic<unsigned int> _num_active;
+
+    // A new loop is started by incrementing `_epoch` and the workers decrement `_pending` when done
+    std::atomic<uint64_t> _epoch{0};
+    std::atomic<unsigned int> _pending{0};
+    std::atomic<unsigned int> _sleeping{0};
+    bool _shutdown = false;
+    std::mutex _mutex;
+    std::condition_variable _cond_epoch;
+
+    // The main loop of the worker thread `tid`
+    void worker(unsigned int tid, bool pin);
+
+    // Execute the chunks of the thread `tid` followed by the chunks it can steal from the other threads
+    void work(unsigned int tid);
+
+public:
+    // Start `num_threads - 1` worker threads (the calling thread is the last one). Zero threads means one per
+    // hardware thread. When `pin` is true, the threads are pinned to a hardware thread each.
+    ThreadPool(unsigned int num_threads, bool pin);
+
+    // Joins the workers
+    ~ThreadPool();
+
+    // Returns the number of threads including the calling thread
+    unsigned int size() const { return static_cast<unsigned int>(_workers.size()) + 1; }
+
+    // Limit the threads that executes the following loops to `num_threads` (at least one and at most `size()`)
+    void setNumThreads(unsigned int num_threads);
+
+    // Execute `body` on the iterations [0, niters) in parallel and returns when all iterations are done.
+    // NB: must be called by the thread that constructed the pool, one loop at a time
+    void parallelFor(LoopBody body, void *args, uint64_t niters);
+};
+
+}} // namespace
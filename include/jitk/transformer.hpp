@@ -25,6 +25,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
+#include <jitk/base_db.hpp>
 
 namespace bohrium {
 namespace jitk {
@@ -32,11 +33,36 @@ namespace jitk {
 // Transpose blocks such that reductions gets as innermost as possible
 void push_reductions_inwards(std::vector<Block> &block_list);
 
+// Interchange the loops of the loop nests in 'block_list' such that the innermost loop is the loop the views
+// traverse with the smallest strides (e.g. the nest of a transposed view). Sweeped loops never move outwards.
+void push_unit_strides_inwards(std::vector<Block> &block_list);
+
 // Splits the 'block_list' in order to achieve a minimum amount of threading (if possible)
 void split_for_threading(std::vector<Block> &block_list, uint64_t min_threading=1000);
 
 // Collapses redundant axes within the 'block_list'
 void collapse_redundant_axes(std::vector<Block> &block_list);
 
+// Tiles (strip-mines and interchanges) the loop nests in 'block_list' that access columns or reuse rows,
+// which makes the nest traverse cache-sized tiles (see `LoopB::tile`).
+// Use 'tile_size' to set the tile size (zero means derived from 'cache_size', which zero means the L2 cache size)
+void tile(std::vector<Block> &block_list, uint64_t tile_size=0, uint64_t cache_size=0);
+
+// Returns the strip-mining of a kernel consisting of 'block_list', which executes all blocks on a chunk of rows of
+// the outermost loops at a time such that its 'kernel_temps' only need a window of rows each. The windows of
+// the temporaries that are read at neighbouring rows include the rows around the chunk, which the writing blocks
+// execute in every chunk. The chunks of all arrays must fit in 'cache_size' (zero means the L2 cache size).
+// The number of rows is zero when the kernel cannot be strip-mined.
+StripMine strip_mine(const std::vector<Block> &block_list, const std::vector<bh_base*> &kernel_temps,
+                     uint64_t cache_size=0);
+
+// Returns the time tiling of a kernel that executes 'steps' repeats of 'block_list' (e.g. the time steps of a
+// stencil), which executes all steps on a chunk of rows before moving on to the next chunk. The rows of each step
+// are skewed such that a chunk only depends on the earlier chunks. The windows of the 'kernel_temps' hold the
+// skewed rows of a chunk and the rows that the later chunks read. The chunks and their skewed rows must fit in
+// 'cache_size' (zero means the L2 cache size). The number of rows is zero when the kernel cannot be time tiled.
+StripMine time_tile(const std::vector<Block> &block_list, const std::vector<bh_base*> &kernel_temps, int64_t steps,
+                    uint64_t cache_size=0);
+
 } // jitk
 } // bohrium
@@ -37,6 +37,10 @@ void write_array_index(const Scope &scope, const bh_view &view, std::stringstrea
 void write_array_index_variables(const Scope &scope, const bh_view &view, std::stringstream &out, int hidden_axis = BH_MAXDIM,
                                  const std::pair<int, int> axis_offset = std::make_pair(BH_MAXDIM, 0));
 
+// Write the part of the array index of 'view' that covers the axes up to and including 'last_axis', e.g. (vo2_0 +i1*10),
+// using the innermost offset of 'view' declared in 'scope' (see `offsets_as_var`)
+void write_array_offset(const Scope &scope, const bh_view &view, int last_axis, std::stringstream &out);
+
 // Write the array subscription, e.g. A[2+i0*1+i1*10], but ignore the loop-variant of 'hidden_axis' if it isn't 'BH_MAXDIM'
 void write_array_subscription(const Scope &scope, const bh_view &view, std::stringstream &out,
                               bool ignore_declared_indexes = false, int hidden_axis = BH_MAXDIM,
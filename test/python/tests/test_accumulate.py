@@ -45,3 +45,27 @@ class test_accumulate_primitives:
         cmd = "R = bh.random.RandomState(42); a = R.random(10, dtype=%s, bohrium=BH); " % dtype
         cmd += "res = M.%s.accumulate(a)" % op
         return cmd
+
+class test_accumulate_parallel:
+    """ Test accumulates large enough to be parallelized over the outermost axis"""
+    def init(self):
+        for dtype in ["np.float64", "np.int64"]:
+            for shape in [(10007,), (2003, 1031)]:
+                cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=%s, bohrium=BH); " % (shape, dtype)
+                for op in ["add", "multiply"]:
+                    yield (cmd, op)
+
+    def test_accumulate(self, arg):
+        (cmd, op) = arg
+        cmd += "res = M.%s.accumulate(a, axis=0)" % op
+        return cmd
+
+    def test_inplace(self, arg):
+        (cmd, op) = arg
+        cmd += "M.%s.accumulate(a, axis=0, out=a); res = a" % op
+        return cmd
+
+    def test_fused(self, arg):
+        (cmd, op) = arg
+        cmd += "b = a + a; res = M.%s.accumulate(b, axis=0); res += a" % op
+        return cmd
@@ -68,6 +68,55 @@ class test_transpose:
         return cmd
 
 
+class test_transpose_interchange:
+    """ Test loop nests over transposed and non-transposed views, where `push_unit_strides_inwards` interchanges
+        the loops such that the innermost loop has the most unit-stride accesses"""
+    def init(self):
+        cmd = "R = bh.random.RandomState(42); "
+        cmd += "a = R.random((67, 131), dtype=np.float64, bohrium=BH); "
+        cmd += "b = R.random((131, 67), dtype=np.float64, bohrium=BH); "
+        cmd += "c = R.random((5, 67, 131), dtype=np.float64, bohrium=BH); "
+        cmd += "d = R.random((131, 5, 67), dtype=np.float64, bohrium=BH); "
+        yield cmd
+
+    def test_mixed(self, cmd):
+        return cmd + "res = a * 2 + b.T"
+
+    def test_majority(self, cmd):
+        return cmd + "res = b.T * a + b.T - b.T / (a + 1)"
+
+    def test_output(self, cmd):
+        return cmd + "res = M.zeros((131, 67)); M.add(a, b.T, res.T); res += b"
+
+    def test_reduce(self, cmd):
+        return cmd + "res = M.add.reduce(a + b.T, axis=0) + M.add.reduce(b.T * a, axis=1).sum()"
+
+    def test_permutation(self, cmd):
+        return cmd + "res = M.transpose(c, (2, 0, 1)) * d + d"
+
+
+class test_tiles:
+    """ Test loop nests that the `tile` transformer traverses in cache-sized tiles, where the extents of the loops
+        aren't multiples of the tile size"""
+    def init(self):
+        cmd = "R = bh.random.RandomState(42); "
+        cmd += "a = R.random((1001, 999), dtype=np.float64, bohrium=BH); "
+        cmd += "b = R.random((37, 100003), dtype=np.float64, bohrium=BH); "
+        yield cmd
+
+    def test_columns(self, cmd):
+        return cmd + "res = a.T[:, :999] + a[:999, :] * 2"
+
+    def test_columns_output(self, cmd):
+        return cmd + "res = M.zeros((999, 1001)); M.multiply(a, 3, res.T); res += 1"
+
+    def test_reduce_rows(self, cmd):
+        return cmd + "res = M.add.reduce(b * 2, axis=0)"
+
+    def test_stencil_rows(self, cmd):
+        return cmd + "res = b[:-2, 1:-1] + b[1:-1, 1:-1] + b[2:, 1:-1] + b[1:-1, :-2] + b[1:-1, 2:]"
+
+
 class test_overlapping:
     def init(self):
         cmd = "R = bh.random.RandomState(42); res = R.random(100, np.float32, bohrium=BH); "
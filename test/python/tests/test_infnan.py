@@ -49,3 +49,17 @@ class test_isfinite:
 
     def test_isfinte(self, cmd):
         return cmd + "res = M.isfinite(a)"
+
+
+class test_tanh_special:
+    def init(self):
+        for dtype in util.TYPES.FLOAT:
+            yield "a = M.zeros(67, dtype=%s); a[1::4] = -0.0; a[2::4] = M.inf; a[3::4] = -M.inf; a[66] = M.nan; " \
+                  % dtype
+
+    def test_tanh(self, cmd):
+        return cmd + "res = M.tanh(a)"
+
+    def test_tanh_signed_zero(self, cmd):
+        # The sign of a zero result is visible as the sign of infinity
+        return cmd + "res = 1 / M.tanh(a)"
@@ -52,4 +52,33 @@ res = M.ones_like(a)
         """Test of the do_while function"""
         (cmd, niter) = args
 
-        return (cmd + "do_while(kernel, %s, a, res)" % (niter), cmd + "M.do_while(kernel, %s, a, res)" % (niter))
\ No newline at end of file
+        return (cmd + "do_while(kernel, %s, a, res)" % (niter), cmd + "M.do_while(kernel, %s, a, res)" % (niter))
+
+class test_loop_stencil:
+    """ Test loops of stencils, which are time-tiled when the number of iterations reaches `time_tile_steps`"""
+    def init(self):
+        cmd = np_loop_src + """
+def jacobi(a):
+    a[1:-1, 1:-1] = (a[:-2, 1:-1] + a[2:, 1:-1] + a[1:-1, :-2] + a[1:-1, 2:]) * 0.25
+
+def double_buffer(a, b):
+    b[1:-1, 1:-1] = (a[:-2, 1:-1] + a[2:, 1:-1] + a[1:-1, :-2] + a[1:-1, 2:] + a[1:-1, 1:-1]) * 0.2
+    a[1:-1, 1:-1] = (b[:-2, 1:-1] + b[2:, 1:-1] + b[1:-1, :-2] + b[1:-1, 2:] + b[1:-1, 1:-1]) * 0.2
+
+R = bh.random.RandomState(42)
+res = R.random((1000, 400), dtype=np.float64, bohrium=BH)
+tmp = M.zeros_like(res)
+
+"""
+        # Include numbers of iterations that aren't multiples of `time_tile_steps`
+        for niters in [1, 3, 4, 8, 9, 11]:
+            yield (cmd, niters)
+
+    def test_jacobi(self, args):
+        (cmd, niters) = args
+        return (cmd + "do_while(jacobi, %d, res)" % niters, cmd + "M.do_while(jacobi, %d, res)" % niters)
+
+    def test_double_buffer(self, args):
+        (cmd, niters) = args
+        return (cmd + "do_while(double_buffer, %d, res, tmp)" % niters,
+                cmd + "M.do_while(double_buffer, %d, res, tmp)" % niters)
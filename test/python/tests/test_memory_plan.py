@@ -0,0 +1,44 @@
+import re
+import bohrium as bh
+from os import environ
+
+
+def plan_reuses():
+    """Returns the number of arrays that got the buffer of a freed array from the memory plan of their flush or
+    None when the backend doesn't plan the memory of its flushes"""
+    stat = bh.backend_messaging.statistic()
+    match = re.search(r"plan reuses:\s*(?:\x1b\[[0-9;]*m)?(\d+)/", stat)
+    return None if match is None else int(match.group(1))
+
+
+class test_memory_plan:
+    """ Test that an array created after an array of the same size is freed gets the freed buffer """
+    def init(self):
+        bh.backend_messaging.statistic_enable_and_reset()
+        if plan_reuses() is None:
+            return
+        # A monolithic kernel allocates `t` and `u` within the kernel instead
+        if environ.get("BH_OPENMP_MONOLITHIC", "").lower() in ("1", "true"):
+            return
+        # The reversed views prevent fusion thus `t` and `u` are arrays of their own kernels
+        cmd = """
+a = M.arange(1000, dtype=np.float64)
+t = a + 1
+r = t[::-1] * 2
+del t
+u = r[::-1] + 3
+r = u[::-1] * 2
+del u
+"""
+        yield cmd
+
+    def test_result(self, cmd):
+        return cmd + "res = r"
+
+    def test_reuse(self, cmd):
+        cmd_np = "res = True"
+        cmd_bh = "import test_memory_plan\n" \
+                 "before = test_memory_plan.plan_reuses()" + cmd + \
+                 "bh.flush()\n" \
+                 "res = test_memory_plan.plan_reuses() > before"
+        return cmd_np, cmd_bh
@@ -0,0 +1,42 @@
+class test_plan_cache:
+    """ Test flushes with the same structure, which replay the execution plan of the first flush """
+    def init(self):
+        cmd = """
+R = bh.random.RandomState(42)
+a = R.random(100, dtype=np.float64, bohrium=BH)
+res = M.zeros(100)
+"""
+        yield cmd
+
+    def test_constants(self, cmd):
+        cmd += """
+for i in range(6):
+    res += a * i + (i - 2)
+    res[i] = i * 3
+    if BH: M.flush()
+"""
+        return cmd
+
+    def test_view_offsets(self, cmd):
+        cmd += """
+for i in range(6):
+    res[i:i + 90] += a[10 - i:100 - i] * 2
+    res[::i + 1] -= 1
+    if BH: M.flush()
+"""
+        return cmd
+
+    def test_frees(self, cmd):
+        cmd += """
+t = a * 2
+for i in range(6):
+    u = t[::-1] + i
+    del t
+    res += u
+    t = M.ones(100) * i
+    if i % 2 == 0:
+        del u
+    if BH: M.flush()
+res += t
+"""
+        return cmd
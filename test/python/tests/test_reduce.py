@@ -37,3 +37,48 @@ class test_reduce_primitives:
         cmd = "R = bh.random.RandomState(42); a = R.random(10, dtype=%s, bohrium=BH); " % dtype
         cmd += "res = M.%s.reduce(a)" % op
         return cmd
+
+
+class test_reduce_parallel:
+    """ Test reductions large enough to be parallelized"""
+    def init(self):
+        for op in ["logical_or", "logical_and", "logical_xor"]:
+            yield (op, "np.bool", (100003,), None)
+        for op in ["maximum", "minimum"]:
+            for dtype in ["np.float64", "np.int64"]:
+                yield (op, dtype, (2003, 1031), 0)
+        for op in ["add", "multiply"]:
+            yield (op, "np.complex128", (2003,), None)
+
+    def test_reduce(self, arg):
+        (op, dtype, shape, axis) = arg
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=%s, bohrium=BH); " % (shape, dtype)
+        if axis is None:
+            cmd += "res = M.%s.reduce(a)" % op
+        else:
+            cmd += "res = M.%s.reduce(a, axis=%d)" % (op, axis)
+        return cmd
+
+    def test_reduce_ones(self, arg):
+        (op, dtype, shape, axis) = arg
+        cmd = "a = M.ones(%s, dtype=%s); " % (shape, dtype)
+        if axis is None:
+            cmd += "res = M.%s.reduce(a)" % op
+        else:
+            cmd += "res = M.%s.reduce(a, axis=%d)" % (op, axis)
+        return cmd
+
+
+class test_reduce_sizes:
+    """ Test a kernel launched with a tiny and a large size in turn, where the number of threads of each launch
+        follows the size of the launch (see `adaptive_threads`)"""
+    def init(self):
+        yield [10, 1000003, 10, 1000003, 3]
+
+    def test_reduce(self, sizes):
+        cmd = "R = bh.random.RandomState(42)\nres = M.zeros(%d)\n" % len(sizes)
+        for i, size in enumerate(sizes):
+            cmd += "a = R.random(%d, dtype=np.float64, bohrium=BH)\n" % size
+            cmd += "res[%d] = M.add.reduce(a * 2 + 1)\n" % i
+            cmd += "if BH: M.flush()\n"
+        return cmd
@@ -0,0 +1,70 @@
+import util
+
+
+class test_simd_views:
+    """ Test innermost loops over float views that aren't contiguous, which the explicit SIMD loops
+        (see `explicit_simd`) must leave to the scalar loop"""
+    def init(self):
+        for dtype in util.TYPES.FLOAT:
+            cmd = "R = bh.random.RandomState(42); "
+            cmd += "a = R.random((37, 1003), dtype=%s, bohrium=BH); " % dtype
+            cmd += "b = R.random((37, 1003), dtype=%s, bohrium=BH); " % dtype
+            yield cmd + "x = a; y = b; "
+            yield cmd + "x = a[:, :1002:2]; y = b[:, 1::2]; "
+            yield cmd + "x = a[:, ::-1]; y = b; "
+            yield cmd + "x = a[:, :37].T; y = b[:, 5:42]; "
+            yield cmd + "x = a[::3, 3::7]; y = b[::3, 2::7]; "
+
+    def test_elementwise(self, cmd):
+        return cmd + "res = M.sqrt(x * y + 1) - x / (y + 1)"
+
+    def test_reduce(self, cmd):
+        return cmd + "res = M.add.reduce(x * y, axis=-1)"
+
+    def test_mixed_views(self, cmd):
+        # The same kernel gets a contiguous and a strided view, which differ in their strides only
+        return cmd + "res = x[:, :20] * 2 + y[:, :20]; res += x[:, -20:] * 2 + y[:, -20:]"
+
+
+class test_simd_dtypes:
+    """ Test innermost loops that mix dtypes, which the explicit SIMD loops must leave to the scalar loop"""
+    def init(self):
+        for dtype1, dtype2 in [("np.float32", "np.float64"), ("np.float64", "np.float32"),
+                               ("np.float64", "np.int32"), ("np.float32", "np.int64")]:
+            cmd = "R = bh.random.RandomState(42); "
+            cmd += "a = R.random(1003, dtype=%s, bohrium=BH); " % dtype1
+            cmd += "b = R.random(1003, dtype=%s, bohrium=BH); " % dtype2
+            yield cmd
+
+    def test_elementwise(self, cmd):
+        return cmd + "res = a * b + a"
+
+    def test_cast(self, cmd):
+        return cmd + "res = a.astype(b.dtype) * b; res += b"
+
+    def test_reduce(self, cmd):
+        return cmd + "res = M.add.reduce(a * b)"
+
+
+class test_unaligned_views:
+    """ Test views that start at an unaligned element of an aligned array (see `assume_aligned`), where the kernel
+        of the aligned view is launched with the unaligned views as well when the offsets are variables"""
+    def init(self):
+        for dtype in util.TYPES.FLOAT:
+            cmd = "R = bh.random.RandomState(42); "
+            cmd += "a = R.random(1031, dtype=%s, bohrium=BH); " % dtype
+            cmd += "b = R.random(1031, dtype=%s, bohrium=BH); " % dtype
+            yield cmd
+
+    def test_offsets(self, cmd):
+        cmd += "res = M.zeros(1024, dtype=a.dtype)\n"
+        for offset in [0, 1, 3, 4, 7]:
+            cmd += "res += a[%d:%d] * b[%d:%d] + 1\n" % (offset, offset + 1024, 7 - offset, 1031 - offset)
+            cmd += "if BH: M.flush()\n"
+        return cmd
+
+    def test_inplace(self, cmd):
+        return cmd + "a[1:] += b[:-1] * 2; a[3:-1] *= b[1:-3]; res = a"
+
+    def test_reduce(self, cmd):
+        return cmd + "res = M.add.reduce(a[1:] * b[:-1]) + M.add.reduce(a[5:-2])"
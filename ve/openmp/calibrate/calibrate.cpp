@@ -0,0 +1,254 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Measures the machine parameters of the cost model of the fusers (see `jitk::TrafficCostModel`) and writes
+ * them to the [openmp] section of the config file.
+ *
+ * Usage: bh_openmp_calibrate [--dry-run] [config file]
+ * The config file defaults to the config file that Bohrium uses (e.g. `BH_CONFIG`).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <bh_config_parser.hpp>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace {
+
+typedef chrono::duration<double> Seconds;
+
+// Returns the best bandwidth (bytes/sec) of the triad `a[i] = b[i] + s * c[i]` on arrays of `nelem` doubles
+double triad_bandwidth(size_t nelem, int repeats) {
+    vector<double> a(nelem, 0), b(nelem, 1), c(nelem, 2);
+    double best = 0;
+    for (int r = 0; r < repeats; ++r) {
+        const auto start = chrono::steady_clock::now();
+        const double s = 1.0 + r;
+        #pragma omp parallel for
+        for (int64_t i = 0; i < static_cast<int64_t>(nelem); ++i) {
+            a[i] = b[i] + s * c[i];
+        }
+        const Seconds time = chrono::steady_clock::now() - start;
+        best = max(best, 3.0 * nelem * sizeof(double) / time.count());
+    }
+    // Make sure the compiler doesn't remove the loop
+    if (a[nelem / 2] < 0) {
+        cout << a[nelem / 2];
+    }
+    return best;
+}
+
+// Returns the latency (sec) of a random memory access by chasing pointers through `nbytes` of memory
+double memory_latency(size_t nbytes) {
+    const size_t n = nbytes / sizeof(size_t);
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), mt19937_64(42));
+    // Link the elements into one random cycle
+    vector<size_t> next(n);
+    for (size_t i = 0; i < n; ++i) {
+        next[order[i]] = order[(i + 1) % n];
+    }
+    const size_t hops = 10000000;
+    size_t p = order[0];
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < hops; ++i) {
+        p = next[p];
+    }
+    const Seconds time = chrono::steady_clock::now() - start;
+    if (p == n) { // Make sure the compiler doesn't remove the loop
+        cout << p;
+    }
+    return time.count() / hops;
+}
+
+// Returns the overhead (sec) of starting and joining a parallel loop
+double parallel_overhead(int num_threads) {
+    const int repeats = 10000;
+    vector<double> data(static_cast<size_t>(num_threads), 0);
+    const auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        #pragma omp parallel for
+        for (int i = 0; i < num_threads; ++i) {
+            data[i] += 1;
+        }
+    }
+    const Seconds time = chrono::steady_clock::now() - start;
+    return time.count() / repeats;
+}
+
+// Returns the value of the sysconf `name` or `default_value` when not available
+uint64_t sysconf_or(int name, uint64_t default_value) {
+    const long ret = sysconf(name);
+    return ret > 0 ? static_cast<uint64_t>(ret) : default_value;
+}
+
+// Writes `options` to `section` of the ini file `path`. Existing options are replaced and new options are
+// appended to the section.
+void write_options(const fs::path &path, const string &section, const vector<pair<string, string> > &options) {
+    vector<string> lines;
+    {
+        ifstream file(path.string());
+        string line;
+        while (getline(file, line)) {
+            lines.push_back(line);
+        }
+    }
+    const auto trim = [](const string &s) {
+        const size_t first = s.find_first_not_of(" \t");
+        const size_t last = s.find_last_not_of(" \t\r");
+        return first == string::npos ? string() : s.substr(first, last - first + 1);
+    };
+
+    // Find the section and the position after its last non-empty line
+    size_t begin = lines.size(), end = lines.size();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const string l = trim(lines[i]);
+        if (l == "[" + section + "]") {
+            begin = i;
+            end = i + 1;
+        } else if (begin != lines.size()) {
+            if (not l.empty() and l[0] == '[') {
+                break;
+            }
+            if (not l.empty()) {
+                end = i + 1;
+            }
+        }
+    }
+    if (begin == lines.size()) {
+        lines.push_back("");
+        lines.push_back("[" + section + "]");
+        begin = lines.size() - 1;
+        end = lines.size();
+    }
+
+    vector<string> appends = {"# Machine parameters of the cost model measured by bh_openmp_calibrate"};
+    for (const auto &option: options) {
+        const string new_line = option.first + " = " + option.second;
+        bool found = false;
+        for (size_t i = begin + 1; i < end; ++i) {
+            const string l = trim(lines[i]);
+            if (l.compare(0, option.first.size(), option.first) == 0 and
+                trim(l.substr(option.first.size())).compare(0, 1, "=") == 0) {
+                lines[i] = new_line;
+                found = true;
+            }
+        }
+        if (not found) {
+            appends.push_back(new_line);
+        }
+    }
+    if (appends.size() > 1) {
+        lines.insert(lines.begin() + end, appends.begin(), appends.end());
+    }
+
+    // We write to a temporary file and rename it, which makes the write atomic
+    const fs::path tmp = path.string() + ".calibrate.tmp";
+    {
+        ofstream file(tmp.string());
+        for (const string &line: lines) {
+            file << line << "\n";
+        }
+        if (not file) {
+            throw runtime_error("Couldn't write " + tmp.string());
+        }
+    }
+    fs::rename(tmp, path);
+}
+}
+
+int main(int argc, char *argv[]) {
+    bool dry_run = false;
+    fs::path config_path;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--dry-run") {
+            dry_run = true;
+        } else if (arg == "-h" or arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--dry-run] [config file]" << endl;
+            return 0;
+        } else {
+            config_path = arg;
+        }
+    }
+    if (config_path.empty()) {
+        config_path = bohrium::ConfigParser(-1).file_path;
+    }
+
+#ifdef _OPENMP
+    const int num_threads = omp_get_max_threads();
+#else
+    const int num_threads = 1;
+#endif
+    const uint64_t cache_line = sysconf_or(_SC_LEVEL1_DCACHE_LINESIZE, 64);
+    uint64_t cache_size = sysconf_or(_SC_LEVEL3_CACHE_SIZE, 0);
+    if (cache_size == 0) {
+        cache_size = sysconf_or(_SC_LEVEL2_CACHE_SIZE, 8 * 1024 * 1024);
+    }
+
+    cout << "Measuring the machine parameters using " << num_threads << " threads..." << endl;
+    // The DRAM arrays are much larger than the cache whereas the cache arrays use half of the cache
+    const size_t dram_nelem = max<size_t>(4 * cache_size, 64 * 1024 * 1024) / sizeof(double);
+    const double dram_bandwidth = triad_bandwidth(dram_nelem, 5);
+    const double cache_bandwidth = triad_bandwidth(cache_size / 2 / 3 / sizeof(double), 100);
+    const double latency = memory_latency(max<size_t>(4 * cache_size, 64 * 1024 * 1024));
+    const double overhead = parallel_overhead(num_threads);
+
+    vector<pair<string, string> > options;
+    const auto add = [&options](const string &name, double value) {
+        stringstream ss;
+        ss << setprecision(4) << value;
+        options.push_back(make_pair(name, ss.str()));
+    };
+    add("machine_dram_bandwidth", dram_bandwidth);
+    add("machine_cache_bandwidth", cache_bandwidth);
+    options.push_back(make_pair("machine_cache_size", to_string(cache_size)));
+    options.push_back(make_pair("machine_cache_line", to_string(cache_line)));
+    add("machine_memory_latency", latency);
+    add("machine_parallel_overhead", overhead);
+    options.push_back(make_pair("machine_threads", to_string(num_threads)));
+    for (const auto &option: options) {
+        cout << "  " << option.first << " = " << option.second << endl;
+    }
+
+    if (not dry_run) {
+        write_options(config_path, "openmp", options);
+        cout << "Wrote the machine parameters to " << config_path << endl;
+    }
+    return 0;
+}
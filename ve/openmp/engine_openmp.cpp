@@ -24,6 +24,9 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <map>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <dlfcn.h>
 #include <jitk/codegen_util.hpp>
 #include <jitk/compiler.hpp>
@@ -33,6 +36,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <thread>
 
 #include <bh_util.hpp>
+#include <bh_memory.h>
 #include "engine_openmp.hpp"
 #include "openmp_util.hpp"
 
@@ -41,25 +45,159 @@ namespace fs = boost::filesystem;
 
 namespace bohrium {
 
+namespace {
+// Returns the number of background compile workers where -1 means one less than the number of hardware threads
+unsigned int num_compiler_workers(int config_value) {
+    if (config_value < 0) {
+        const unsigned int nthreads = std::thread::hardware_concurrency();
+        return nthreads > 1 ? nthreads - 1 : 0;
+    }
+    return static_cast<unsigned int>(config_value);
+}
+
+// Returns the 'data_list' argument of a launcher function: the data pointers of `non_temps`
+vector<void*> data_list_arg(const std::vector<bh_base*> &non_temps) {
+    vector<void*> ret;
+    ret.reserve(non_temps.size());
+    for(bh_base *base: non_temps) {
+        assert(base->data != NULL);
+        ret.push_back(base->data);
+    }
+    return ret;
+}
+
+// Returns the 'offset_strides' argument of a launcher function: the offset-and-strides followed by the extents
+vector<uint64_t> offset_strides_arg(const std::vector<const bh_view*> &offset_strides,
+                                    const std::vector<uint64_t> &extents) {
+    vector<uint64_t> ret;
+    ret.reserve(offset_strides.size() + extents.size());
+    for (const bh_view *view: offset_strides) {
+        const uint64_t t = (uint64_t) view->start;
+        ret.push_back(t);
+        for (int i=0; i<view->ndim; ++i) {
+            const uint64_t s = (uint64_t) view->stride[i];
+            ret.push_back(s);
+        }
+    }
+    ret.insert(ret.end(), extents.begin(), extents.end());
+    return ret;
+}
+
+// Returns the NUMA placement policy named `name`
+bh_numa_policy numa_policy(const std::string &name) {
+    if (name == "none") {
+        return BH_NUMA_NONE;
+    } else if (name == "interleave") {
+        return BH_NUMA_INTERLEAVE;
+    } else if (name == "first_touch") {
+        return BH_NUMA_FIRST_TOUCH;
+    }
+    throw std::runtime_error("Unknown NUMA policy!");
+}
+
+// Bind OpenMP thread `i` to the CPU of kernel thread `i` (see `bh_memory_numa_thread_cpu()`) unless the user
+// already binds the threads. NB: the OpenMP runtime reads the environment when the first kernel loads it.
+void pin_openmp_threads(unsigned int num_threads) {
+    stringstream places;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        const int cpu = bh_memory_numa_thread_cpu(i);
+        if (cpu < 0) {
+            return;
+        }
+        places << (i == 0 ? "" : ",") << "{" << cpu << "}";
+    }
+    setenv("OMP_PLACES", places.str().c_str(), 0);
+    setenv("OMP_PROC_BIND", "close", 0);
+}
+
+// Returns the 'constants' argument of a launcher function: the constant values of `constants`
+vector<bh_constant_value> constants_arg(const std::vector<const bh_instruction*> &constants) {
+    vector<bh_constant_value> ret;
+    ret.reserve(constants.size());
+    for (const bh_instruction* instr: constants) {
+        ret.push_back(instr->constant.value);
+    }
+    return ret;
+}
+}
+
 EngineOpenMP::EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat) :
     EngineCPU(config, stat),
-    compiler(config.get<string>("compiler_cmd"), verbose, config.file_dir.string())
+    compiler(config.get<string>("compiler_cmd"), verbose, config.file_dir.string()),
+    fallback_compiler(config.defaultGet<string>("compiler_fallback_cmd", ""), verbose, config.file_dir.string()),
+    tier1_compiler(config.defaultGet<string>("compiler_tier1_cmd", config.get<string>("compiler_cmd")), verbose,
+                   config.file_dir.string()),
+    tier_up_calls(config.defaultGet<uint64_t>("tier_up_calls", 0)),
+    tier_up_time(config.defaultGet<double>("tier_up_time", 0)),
+    use_plan_cache(config.defaultGet<bool>("plan_cache", true)),
+    assume_aligned(config.defaultGet<bool>("assume_aligned", true)),
+    plan_cache(stat, config.defaultGet<uint64_t>("plan_cache_size", 1000)),
+    parallel_scan(config.defaultGet<bool>("parallel_scan", false)),
+    explicit_simd(config.defaultGet<bool>("explicit_simd", true)),
+    parallel_threshold(config.defaultGet<uint64_t>("parallel_threshold", 1024)),
+    adaptive_threads(config.defaultGet<bool>("adaptive_threads", true)),
+    adaptive_thread_time(config.defaultGet<double>("adaptive_thread_time", 0.0001)),
+    parallel_overhead(config.defaultGet<double>("machine_parallel_overhead", 5e-6)),
+    compile_pool(num_compiler_workers(config.defaultGet<int>("compiler_workers", -1)))
 {
     compilation_hash = util::hash(compiler.cmd_template);
+    fallback_compilation_hash = util::hash(fallback_compiler.cmd_template);
+    // NB: the specialized kernels must not share binary files with the regular kernels
+    tier1_compilation_hash = util::hash(tier1_compiler.cmd_template, 1);
+
+    // Processes that share the cache dir coordinate their compilations through lock files
+    if (not (verbose or cache_bin_dir.empty()) and config.defaultGet<bool>("cache_lock", true)) {
+        cache_lock_dir = cache_bin_dir / "locks";
+        jitk::create_directories(cache_lock_dir);
+    }
+
+    const bool use_thread_pool = config.defaultGet<bool>("thread_pool", false);
+    if (use_thread_pool) {
+        const int n = config.defaultGet<int>("thread_pool_size", 0);
+        max_threads = n > 0 ? static_cast<unsigned int>(n) : std::max(1u, std::thread::hardware_concurrency());
+    } else {
+        // NB: the OpenMP runtime of the kernels uses `OMP_NUM_THREADS` threads
+        const char *omp_num_threads = std::getenv("OMP_NUM_THREADS");
+        const int n = omp_num_threads == nullptr ? 0 : std::atoi(omp_num_threads);
+        max_threads = n > 0 ? static_cast<unsigned int>(n) : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // NB: the NUMA placement must be configured before any thread is pinned
+    bh_memory_numa_config(numa_policy(config.defaultGet<string>("numa_policy", "none")), max_threads);
+    const bool pin_threads = config.defaultGet<bool>("pin_threads", false);
+    if (pin_threads) {
+        pin_openmp_threads(max_threads);
+    }
+    if (use_thread_pool) {
+        thread_pool.reset(new jitk::ThreadPool(max_threads, pin_threads));
+    }
 }
 
 EngineOpenMP::~EngineOpenMP() {
+    // Let the background compiles finish before we touch the tmp dir
+    compile_pool.shutdown();
+
     // Move JIT kernels to the cache dir
+    // NB: kernels only executed through the fallback path might have finished their regular compile as well
     if (not cache_bin_dir.empty()) {
         try {
-            for (const auto &kernel: _functions) {
-                const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
+            const auto copy2cache = [this](uint64_t compilation_hash, uint64_t hash) {
+                const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
                 if (fs::exists(src)) {
-                    const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
+                    const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+                    // NB: other processes might `dlopen()` or write `dst` concurrently
                     if (not fs::exists(dst)) {
-                        fs::copy_file(src, dst);
+                        jitk::copy_file_atomically(src, dst);
                     }
                 }
+            };
+            for (const auto *functions: {&_functions, &_fallback_functions}) {
+                for (const auto &kernel: *functions) {
+                    copy2cache(compilation_hash, kernel.first);
+                }
+            }
+            for (const auto &kernel: _tier1_functions) {
+                copy2cache(tier1_compilation_hash, kernel.first);
             }
         } catch (const boost::filesystem::filesystem_error &e) {
             cout << "Warning: couldn't write JIT kernels to disk to " << cache_bin_dir
@@ -111,26 +249,47 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const std::string
 
     fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
 
-    // If the binary file of the kernel doesn't exist we create it
-    if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
+    if (compile_pool.exist(hash)) {
+        // The kernel has been compiled (or is being compiled) in the background
+        ++stat.kernel_cache_misses;
+        stat.time_compile_hidden += compile_pool.wait(hash);
+        binfile = compiledBinfile(compilation_hash, hash);
+    } else if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
+        // If the binary file of the kernel doesn't exist we create it
         ++stat.kernel_cache_misses;
-
-        // We create the binary file in the tmp dir
-        binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
 
         // Write the source file and compile it (reading from disk)
         // NB: this is a nice debug option, but will hurt performance
         if (verbose) {
+            // We create the binary file in the tmp dir
+            binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
             std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
             stat.addKernel(source_filename);
             fs::path srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
             compiler.compile(binfile.string(), srcfile.string());
         } else {
-            // Pipe the source directly into the compiler thus no source file is written
-            compiler.compile(binfile.string(), source.c_str(), source.size());
+            compileKernel(compiler, compilation_hash, hash, source);
+            binfile = compiledBinfile(compilation_hash, hash);
         }
     }
+    _functions[hash] = loadFunction(binfile, func_name);
+    return _functions.at(hash);
+}
+
+KernelFunction EngineOpenMP::getFallbackFunction(const string &source, const std::string &func_name) {
+    uint64_t hash = util::hash(source);
+
+    if (_fallback_functions.find(hash) != _fallback_functions.end()) {
+        return _fallback_functions.at(hash);
+    }
+    // NB: the fallback kernels are never moved to the cache dir
+    const fs::path binfile = tmp_bin_dir / jitk::hash_filename(fallback_compilation_hash, hash, ".so");
+    fallback_compiler.compile(binfile.string(), source.c_str(), source.size());
+    _fallback_functions[hash] = loadFunction(binfile, func_name);
+    return _fallback_functions.at(hash);
+}
 
+KernelFunction EngineOpenMP::loadFunction(const fs::path &binfile, const std::string &func_name) {
     // Load the shared library
     void *lib_handle = dlopen(binfile.string().c_str(), RTLD_NOW);
     if (lib_handle == nullptr) {
@@ -142,22 +301,87 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const std::string
     // Load the launcher function
     // The (clumsy) cast conforms with the ISO C standard and will
     // avoid any compiler warnings.
+    KernelFunction ret;
     dlerror(); // Reset errors
-    *(void **) (&_functions[hash]) = dlsym(lib_handle, func_name.c_str());
+    *(void **) (&ret) = dlsym(lib_handle, func_name.c_str());
     const char* dlsym_error = dlerror();
     if (dlsym_error != nullptr) {
         cerr << "Cannot load function launcher(): " << dlsym_error << endl;
         throw runtime_error("VE-OPENMP: Cannot load function launcher()");
     }
-    return _functions.at(hash);
+    return ret;
+}
+
+void EngineOpenMP::prefetch(const string &source, uint64_t codegen_hash) {
+    if (not compile_pool.enabled()) {
+        return;
+    }
+    const uint64_t hash = util::hash(source);
+
+    // Is the kernel already loaded, compiling, or in the cache dir?
+    if (_functions.find(hash) != _functions.end() or compile_pool.exist(hash)) {
+        return;
+    }
+    if (not (verbose or cache_bin_dir.empty()) and
+        fs::exists(cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so"))) {
+        return;
+    }
+
+    // The job writes the binary file, which `getFunction()` loads when the kernel is needed
+    if (verbose) {
+        const fs::path binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+        std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
+        stat.addKernel(source_filename);
+        const fs::path srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
+        compile_pool.submit(hash, [this, binfile, srcfile]() {
+            compiler.compile(binfile.string(), srcfile.string());
+        });
+    } else {
+        compile_pool.submit(hash, [this, hash, source]() {
+            compileKernel(compiler, compilation_hash, hash, source);
+        });
+    }
+}
+
+void EngineOpenMP::compileKernel(const jitk::Compiler &compiler, uint64_t compilation_hash,
+                                 uint64_t hash, const std::string &source) const {
+    const std::string filename = jitk::hash_filename(compilation_hash, hash, ".so");
+    const fs::path tmpfile = tmp_bin_dir / filename;
+
+    if (cache_lock_dir.empty()) {
+        // Pipe the source directly into the compiler thus no source file is written
+        compiler.compile(tmpfile.string(), source.c_str(), source.size());
+        return;
+    }
+
+    // We hold the lock of the kernel while compiling. Processes that need the same kernel wait on the lock
+    // and find the kernel in the cache dir when it is released.
+    const jitk::FileLock lock(cache_lock_dir / (filename + ".lock"));
+    const fs::path cachefile = cache_bin_dir / filename;
+    if (fs::exists(cachefile)) { // Another process has compiled the kernel while we waited
+        return;
+    }
+    compiler.compile(tmpfile.string(), source.c_str(), source.size());
+    jitk::copy_file_atomically(tmpfile, cachefile);
 }
 
+fs::path EngineOpenMP::compiledBinfile(uint64_t compilation_hash, uint64_t hash) const {
+    // The kernel is in the tmp dir unless another process compiled it (see `compileKernel()`)
+    const std::string filename = jitk::hash_filename(compilation_hash, hash, ".so");
+    if (cache_lock_dir.empty() or fs::exists(tmp_bin_dir / filename)) {
+        return tmp_bin_dir / filename;
+    } else {
+        return cache_bin_dir / filename;
+    }
+}
 
 void EngineOpenMP::execute(const std::string &source,
                            uint64_t codegen_hash,
                            const std::vector<bh_base*> &non_temps,
                            const std::vector<const bh_view*> &offset_strides,
-                           const std::vector<const bh_instruction*> &constants) {
+                           const std::vector<uint64_t> &extents,
+                           const std::vector<const bh_instruction*> &constants,
+                           uint64_t work) {
     // Notice, we use a "pure" hash of `source` to make sure that the `source_filename` always
     // corresponds to `source` even if `codegen_hash` is buggy.
     uint64_t hash = util::hash(source);
@@ -171,44 +395,271 @@ void EngineOpenMP::execute(const std::string &source,
     // Compile the kernel
     auto tbuild = chrono::steady_clock::now();
     string func_name; { stringstream t; t << "launcher_" << codegen_hash; func_name = t.str(); }
-    KernelFunction func = getFunction(source, func_name);
+    KernelFunction func;
+    if (not fallback_compiler.cmd_template.empty() and compile_pool.exist(hash) and not compile_pool.ready(hash)) {
+        // The kernel is still compiling in the background, thus we use the fallback kernel for now
+        // NB: the fallback kernel is temporary thus a plan that launches it is never final
+        func = getFallbackFunction(source, func_name);
+        _plan_final = false;
+    } else {
+        func = getFunction(source, func_name);
+    }
     assert(func != nullptr);
     stat.time_compile += chrono::steady_clock::now() - tbuild;
 
-    // Create a 'data_list' of data pointers
-    vector<void*> data_list;
-    data_list.reserve(non_temps.size());
-    for(bh_base *base: non_temps) {
-        assert(base->data != NULL);
-        data_list.push_back(base->data);
+    // A generic kernel that isn't hot yet might become specialized later (see `executePlan()`)
+    const bool may_tier_up = (tier_up_calls > 0 or tier_up_time > 0) and not isHot(source);
+
+    vector<void*> data_list = data_list_arg(non_temps);
+    vector<uint64_t> offset_and_strides = offset_strides_arg(offset_strides, extents);
+    vector<bh_constant_value> constant_arg = constants_arg(constants);
+    jitk::KernelStats &kernel_stat = stat.time_per_kernel[source_filename];
+    const auto texec = launch(func, data_list, offset_and_strides, constant_arg, work, kernel_stat);
+    stat.time_exec += texec;
+    kernel_stat.register_exec_time(texec);
+    recordKernel(func, non_temps, offset_and_strides, constants, work, source_filename, false, may_tier_up);
+}
+
+chrono::duration<double> EngineOpenMP::launch(KernelFunction func,
+                                              std::vector<void*> &data_list,
+                                              std::vector<uint64_t> &offset_and_strides,
+                                              std::vector<bh_constant_value> &constant_arg,
+                                              uint64_t work,
+                                              jitk::KernelStats &kernel_stat) {
+    // Let's give each thread at least `adaptive_thread_time` of the work, which we know from previous launches
+    unsigned int num_threads = max_threads;
+    if (adaptive_threads and kernel_stat.iteration_time > 0 and work > 0) {
+        const double n = std::floor(kernel_stat.iteration_time * work / adaptive_thread_time);
+        num_threads = static_cast<unsigned int>(std::max(1.0, std::min(n, static_cast<double>(max_threads))));
+    }
+    if (thread_pool != nullptr) {
+        thread_pool->setNumThreads(num_threads);
     }
 
-    // And the offset-and-strides
-    vector<uint64_t> offset_and_strides;
-    offset_and_strides.reserve(offset_strides.size());
-    for (const bh_view *view: offset_strides) {
-        const uint64_t t = (uint64_t) view->start;
-        offset_and_strides.push_back(t);
-        for (int i=0; i<view->ndim; ++i) {
-            const uint64_t s = (uint64_t) view->stride[i];
-            offset_and_strides.push_back(s);
+    auto start_exec = chrono::steady_clock::now();
+    // Call the launcher function, which will execute the kernel
+    func(&data_list[0], &offset_and_strides[0], &constant_arg[0], thread_pool.get(), jitk::ThreadPool::parallelFor,
+         static_cast<int>(num_threads));
+    const chrono::duration<double> ret = chrono::steady_clock::now() - start_exec;
+    if (work > 0) {
+        const double overhead = num_threads > 1 ? parallel_overhead : 0;
+        kernel_stat.register_iteration_time(std::max(0.0, ret.count() - overhead) * num_threads / work);
+    }
+    if (stat.enabled) {
+        for (void *data: data_list) {
+            bh_memory_numa_sample(data, num_threads, &stat.numa_sampled_pages, &stat.numa_remote_pages);
+        }
+    }
+    return ret;
+}
+
+void EngineOpenMP::recordKernel(KernelFunction func,
+                                const std::vector<bh_base*> &non_temps,
+                                const std::vector<uint64_t> &offset_and_strides,
+                                const std::vector<const bh_instruction*> &constants,
+                                uint64_t work,
+                                const std::string &kernel_name,
+                                bool tier1,
+                                bool may_tier_up) {
+    if (_plan == nullptr) {
+        return;
+    }
+    jitk::PlanKernel kernel;
+    kernel.func = func;
+    for (const bh_base *base: non_temps) {
+        auto it = _plan_base_ids.find(base);
+        if (it == _plan_base_ids.end()) { // Shouldn't happen but a plan that misses an array is useless
+            _plan_final = false;
+            return;
+        }
+        kernel.params.push_back(it->second);
+    }
+    // NB: the kernel assumes that its arrays are aligned when all of them are (see `jitk::SymbolTable`)
+    if (assume_aligned) {
+        bool aligned = true;
+        for (const bh_base *base: non_temps) {
+            aligned = aligned and BH_MEMORY_IS_ALIGNED(base->data);
+        }
+        if (aligned) {
+            _plan->aligned.insert(_plan->aligned.end(), kernel.params.begin(), kernel.params.end());
+        }
+    }
+    kernel.offset_strides = offset_and_strides;
+    // NB: `handleExecution()` converts the origin IDs of the constants into indexes in the BhIR
+    for (const bh_instruction *instr: constants) {
+        kernel.constants.push_back(static_cast<size_t>(instr->origin_id));
+    }
+    kernel.work = work;
+    kernel.kernel_name = kernel_name;
+    kernel.tier1 = tier1;
+    kernel.may_tier_up = may_tier_up;
+    _plan->kernels.push_back(std::move(kernel));
+}
+
+void EngineOpenMP::handleExecution(BhIR *bhir) {
+    if (not use_plan_cache) {
+        EngineCPU::handleExecution(bhir);
+        return;
+    }
+
+    vector<bh_base*> bases;
+    const vector<uint64_t> plan_key = jitk::PlanCache::key(*bhir, bases);
+    jitk::ExecutionPlan *plan = plan_cache.get(plan_key, *bhir, bases);
+    if (plan != nullptr) {
+        if (not executePlan(*plan, *bhir, bases)) {
+            plan_cache.erase(plan_key);
+        }
+        return;
+    }
+
+    // Let's execute `bhir` the regular way while recording the kernel launches
+    jitk::ExecutionPlan new_plan;
+    _plan = &new_plan;
+    _plan_final = true;
+    _plan_base_ids.clear();
+    for (size_t i = 0; i < bases.size(); ++i) {
+        _plan_base_ids.insert(make_pair(bases[i], i));
+    }
+    const uint64_t work_below_threshold = stat.threading_below_threshold;
+    EngineCPU::handleExecution(bhir);
+    _plan = nullptr;
+    new_plan.work_below_threshold = stat.threading_below_threshold - work_below_threshold;
+
+    if (_plan_final) {
+        // The origin ID of an instruction is its index in the list of computed instructions
+        set<bh_base*> frees;
+        const vector<bh_instruction*> instr_list = jitk::remove_non_computed_system_instr(bhir->instr_list, frees);
+        for (jitk::PlanKernel &kernel: new_plan.kernels) {
+            for (size_t &instr_idx: kernel.constants) {
+                instr_idx = static_cast<size_t>(instr_list.at(instr_idx) - &bhir->instr_list[0]);
+            }
         }
+        plan_cache.insert(plan_key, *bhir, bases, std::move(new_plan));
     }
+}
 
-    // And the constants
+bool EngineOpenMP::executePlan(jitk::ExecutionPlan &plan, const BhIR &bhir, const std::vector<bh_base*> &bases) {
+    const auto texecution = chrono::steady_clock::now();
+
+    // Some statistics
+    stat.record(bhir);
+    stat.threading_below_threshold += plan.work_below_threshold;
+
+    for (size_t base_idx: plan.frees) {
+        bh_data_free(bases[base_idx]);
+    }
+
+    bool outdated = false;
+    vector<void*> data_list;
     vector<bh_constant_value> constant_arg;
-    constant_arg.reserve(constants.size());
-    for (const bh_instruction* instr: constants) {
-        constant_arg.push_back(instr->constant.value);
+    jitk::MemoryPlan::Execution memory(plan.memory, stat);
+    for (size_t i = 0; i < plan.kernels.size(); ++i) {
+        jitk::PlanKernel &kernel = plan.kernels[i];
+        if (mem_plan) {
+            memory.assign(i, bases);
+        }
+        // Make sure all arrays are allocated
+        data_list.clear();
+        for (size_t base_idx: kernel.params) {
+            bh_base *base = bases[base_idx];
+            bh_data_malloc(base);
+            data_list.push_back(base->data);
+        }
+        constant_arg.clear();
+        for (size_t instr_idx: kernel.constants) {
+            constant_arg.push_back(bhir.instr_list[instr_idx].constant.value);
+        }
+
+        jitk::KernelStats &kernel_stat = stat.time_per_kernel[kernel.kernel_name];
+        const auto texec = launch(kernel.func, data_list, kernel.offset_strides, constant_arg, kernel.work,
+                                  kernel_stat);
+        stat.time_exec += texec;
+        if (kernel.tier1) {
+            kernel_stat.register_exec_time_tier1(texec);
+        } else {
+            kernel_stat.register_exec_time(texec);
+            // When the generic kernel gets hot, the plan should launch the specialized kernel instead
+            if (kernel.may_tier_up and reachedTierUp(kernel_stat)) {
+                outdated = true;
+            }
+        }
+
+        for (size_t base_idx: kernel.frees) {
+            memory.free(bases[base_idx]);
+        }
     }
+    stat.time_total_execution += chrono::steady_clock::now() - texecution;
+    return not outdated;
+}
 
-    auto start_exec = chrono::steady_clock::now();
-    // Call the launcher function, which will execute the kernel
-    func(&data_list[0], &offset_and_strides[0], &constant_arg[0]);
-    auto texec = chrono::steady_clock::now() - start_exec;
-    stat.time_exec += texec;
-    stat.time_per_kernel[source_filename].register_exec_time(texec);
+bool EngineOpenMP::reachedTierUp(const jitk::KernelStats &kernel) const {
+    return (tier_up_calls > 0 and kernel.num_calls >= tier_up_calls) or
+           (tier_up_time > 0 and kernel.total_time.count() >= tier_up_time);
+}
 
+bool EngineOpenMP::isHot(const std::string &source) {
+    if (tier_up_calls == 0 and tier_up_time <= 0) {
+        return false;
+    }
+    const std::string source_filename = jitk::hash_filename(compilation_hash, util::hash(source), ".c");
+    auto it = stat.time_per_kernel.find(source_filename);
+    return it != stat.time_per_kernel.end() and reachedTierUp(it->second);
+}
+
+bool EngineOpenMP::executeSpecialized(const std::string &source,
+                                      uint64_t codegen_hash,
+                                      const std::vector<bh_base*> &non_temps,
+                                      const std::string &generic_source,
+                                      uint64_t work) {
+    const uint64_t hash = util::hash(source);
+
+    auto func = _tier1_functions.find(hash);
+    if (func == _tier1_functions.end()) {
+        fs::path binfile = cache_bin_dir / jitk::hash_filename(tier1_compilation_hash, hash, ".so");
+        if (cache_bin_dir.empty() or not fs::exists(binfile)) {
+            if (compile_pool.enabled()) {
+                // We compile the specialized kernel in the background and use the generic kernel until it is ready
+                // NB: the job key must not collide with the regular compilation of `source`
+                const uint64_t key = hash ^ tier1_compilation_hash;
+                if (not compile_pool.exist(key)) {
+                    compile_pool.submit(key, [this, hash, source]() {
+                        compileKernel(tier1_compiler, tier1_compilation_hash, hash, source);
+                    });
+                    _plan_final = false;
+                    return false;
+                }
+                if (not compile_pool.ready(key)) {
+                    _plan_final = false;
+                    return false;
+                }
+                stat.time_compile_hidden += compile_pool.wait(key);
+            } else {
+                const auto tbuild = chrono::steady_clock::now();
+                compileKernel(tier1_compiler, tier1_compilation_hash, hash, source);
+                stat.time_compile += chrono::steady_clock::now() - tbuild;
+            }
+            binfile = compiledBinfile(tier1_compilation_hash, hash);
+        }
+        string func_name; { stringstream t; t << "launcher_" << codegen_hash; func_name = t.str(); }
+        func = _tier1_functions.insert(make_pair(hash, loadFunction(binfile, func_name))).first;
+    }
+
+    // Make sure all arrays are allocated
+    for (bh_base *base: non_temps) {
+        bh_data_malloc(base);
+    }
+
+    vector<void*> data_list = data_list_arg(non_temps);
+    vector<uint64_t> offset_and_strides;
+    vector<bh_constant_value> constant_arg;
+    // We register the time at the generic kernel, which makes it easy to compare the two
+    const std::string source_filename = jitk::hash_filename(compilation_hash, util::hash(generic_source), ".c");
+    jitk::KernelStats &kernel_stat = stat.time_per_kernel[source_filename];
+    const auto texec = launch(func->second, data_list, offset_and_strides, constant_arg, work, kernel_stat);
+    stat.time_exec += texec;
+    kernel_stat.register_exec_time_tier1(texec);
+    recordKernel(func->second, non_temps, offset_and_strides, {}, work, source_filename, true, false);
+    return true;
 }
 
 void EngineOpenMP::setConstructorFlag(std::vector<bh_instruction*> &instr_list) {
@@ -223,6 +674,21 @@ void EngineOpenMP::loopHeadWriter(const jitk::SymbolTable &symbols,
                                   bool loop_is_peeled,
                                   const vector<uint64_t> &thread_stack,
                                   stringstream &out) {
+    // The accumulating loop of a one-dimensional scan iterates over the chunk of the thread (see `writeScanBlock()`)
+    if (block._id == _scan_block_id) {
+        out << "for(uint64_t i0 = scan_begin + 1; i0 < scan_end; ++i0) {\n";
+        return;
+    }
+
+    // The vectorized iterations go before the regular loop, which then handles the remainder
+    string simd_begin;
+    const bool simd = writeSimdLoop(symbols, scope, block, loop_is_peeled, simd_begin, out);
+    // NB: GCC flags the "omp simd" remainder loop as undefined behavior when it might start beyond its end
+    if (simd) {
+        out << "if (" << simd_begin << " < " << loopEnd(symbols, block) << ")\n";
+        util::spaces(out, 4 + block.rank * 4);
+    }
+
     // Let's write the OpenMP loop header
     int64_t for_loop_size = block.size;
     // If the for-loop has been peeled, its size is one less
@@ -230,20 +696,104 @@ void EngineOpenMP::loopHeadWriter(const jitk::SymbolTable &symbols,
         --for_loop_size;
     }
     // No need to parallel one-sized loops
-    if (for_loop_size > 1) {
+    // NB: when the loop size is a variable, the source code must not depend on the size
+    if (symbols.shape_as_var or for_loop_size > 1) {
         writeHeader(symbols, scope, block, out);
     }
     // Write the for-loop header
     string itername;
     { stringstream t; t << "i" << block.rank; itername = t.str(); }
     out << "for(uint64_t " << itername;
-    if (block._sweeps.size() > 0 and loop_is_peeled) {
+    if (simd) {
+        out << " = " << simd_begin << "; ";
+    } else if (block._sweeps.size() > 0 and loop_is_peeled) {
          // If the for-loop has been peeled, we should start at 1
         out << " = 1; ";
     } else {
-        out << " = 0; ";
+        out << " = " << loopBegin(block) << "; ";
+    }
+    out << itername << " < " << loopEnd(symbols, block) << "; ++" << itername << ") {\n";
+}
+
+void EngineOpenMP::tileHeadWriter(const jitk::SymbolTable &symbols,
+                                  const vector<const jitk::LoopB*> &tiled,
+                                  stringstream &out) {
+    // The threads share the tiles, which are independent since the tiled loops aren't sweeped
+    if (config.defaultGet<bool>("compiler_openmp", false)) {
+        util::spaces(out, 4);
+        out << "#pragma omp parallel for num_threads(bh_num_threads)";
+        if (tiled.size() > 1) {
+            out << " collapse(" << tiled.size() << ")";
+        }
+        out << "\n";
+    }
+    for (const jitk::LoopB *loop: tiled) {
+        const string itername = "i" + std::to_string(loop->rank) + "_tile";
+        const string size = loopSize(symbols, *loop);
+        util::spaces(out, 4);
+        out << "for(uint64_t " << itername << " = 0; " << itername << " < " << size << "; "
+            << itername << " += " << loop->tile << ") {\n";
+    }
+    // The end of each tile, which is the end of the tiled loop (see `loopEnd()`)
+    for (const jitk::LoopB *loop: tiled) {
+        const string itername = "i" + std::to_string(loop->rank) + "_tile";
+        const string size = loopSize(symbols, *loop);
+        util::spaces(out, 4);
+        out << "const uint64_t " << itername << "_end = " << itername << " + " << loop->tile << " < " << size
+            << " ? " << itername << " + " << loop->tile << " : " << size << ";\n";
+    }
+}
+
+bool EngineOpenMP::parallelClauses(const jitk::SymbolTable &symbols, const jitk::LoopB &block, string &clauses) const {
+    // We approximate the work of the loop nest by the sizes of its first loops
+    const vector<const jitk::LoopB*> loops = jitk::get_first_loop_blocks(block);
+    stringstream ss;
+    if (symbols.shape_as_var) {
+        ss << " if(";
+        for (size_t i = 0; i < loops.size(); ++i) {
+            ss << (i == 0 ? "" : " * ") << loopSize(symbols, *loops[i]);
+        }
+        ss << " >= " << parallel_threshold << ")";
+    } else {
+        uint64_t work = 1;
+        for (const jitk::LoopB *loop: loops) {
+            work *= static_cast<uint64_t>(std::max(int64_t{1}, loop->size));
+            if (work >= parallel_threshold) {
+                break;
+            }
+        }
+        if (work < parallel_threshold) {
+            return false;
+        }
+    }
+    // The number of threads of each launch is chosen by `launch()`
+    ss << " num_threads(bh_num_threads)";
+    clauses = ss.str();
+    return true;
+}
+
+std::string EngineOpenMP::loopSize(const jitk::SymbolTable &symbols, const jitk::LoopB &block) const {
+    stringstream ss;
+    if (symbols.shape_as_var) {
+        ss << "e" << _loop_size_ids.at(block._id);
+    } else {
+        ss << block.size;
+    }
+    return ss.str();
+}
+
+std::string EngineOpenMP::loopEnd(const jitk::SymbolTable &symbols, const jitk::LoopB &block) const {
+    // A tiled loop ends at the end of the tile (see `tileHeadWriter()`)
+    if (block.tile > 0) {
+        return "i" + std::to_string(block.rank) + "_tile_end";
     }
-    out << itername << " < " << block.size << "; ++" << itername << ") {\n";
+    if (_within_pool and block.rank == 0) {
+        return "i0_end";
+    }
+    if (not _strip_end.empty() and block.rank == 0) {
+        return _strip_end;
+    }
+    return loopSize(symbols, block);
 }
 
 // Writing the OpenMP header, which include "parallel for" and "simd"
@@ -265,7 +815,9 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
 
     stringstream ss;
     // "OpenMP for" goes to the outermost loop
-    if (block.rank == 0 and openmp_compatible(block)) {
+    string clauses;
+    if (block.rank == 0 and not (_rows or _within_tiles or _within_pool or _within_chunks) and openmp_compatible(block, scope) and
+        parallelClauses(symbols, block, clauses)) {
         ss << " parallel for";
         // Since we are doing parallel for, we should either do OpenMP reductions or protect the sweep instructions
         for (const jitk::InstrPtr &instr: ordered_block_sweeps) {
@@ -273,12 +825,13 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
             const bh_view &view = instr->operand[0];
             if (openmp_reduce_compatible(instr->opcode) and (scope.isScalarReplaced(view) or scope.isTmp(view.base))) {
                 openmp_reductions.push_back(instr);
-            } else if (openmp_atomic_compatible(instr->opcode)) {
-                scope.insertOpenmpAtomic(view);
             } else {
-                scope.insertOpenmpCritical(view);
+                scope.insertOpenmpAtomic(view);
             }
         }
+    } else if (_rows and block.rank == 1) {
+        // The threads of the parallel region around the block share the rows (see `writeRowsBlock()`)
+        ss << " for";
     }
 
     // "OpenMP SIMD" goes to the innermost loop (which might also be the outermost loop)
@@ -291,6 +844,9 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
         }
     }
 
+    // NB: the clauses of "parallel for" must follow "simd"
+    ss << clauses;
+
     //Let's write the OpenMP reductions
     for (const jitk::InstrPtr &instr: openmp_reductions) {
         assert(instr->operand.size() == 3);
@@ -305,48 +861,674 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
     }
 }
 
+std::string EngineOpenMP::loopBegin(const jitk::LoopB &block) {
+    // The outermost loop of a pool block iterates over the share of the thread (see `writePoolBlock()`)
+    if (_within_pool and block.rank == 0) {
+        return "i0_begin";
+    }
+    // The outermost loops of a strip-mined kernel iterate over the chunk of the thread (see `writeKernel()`)
+    if (not _strip_begin.empty() and block.rank == 0) {
+        return _strip_begin;
+    }
+    if (block.tile > 0) {
+        return "i" + std::to_string(block.rank) + "_tile";
+    }
+    return block._id == _scan_block_id ? "scan_begin" : "0";
+}
+
+bool EngineOpenMP::writeRowsBlock(const jitk::SymbolTable &symbols, const jitk::LoopB &block, stringstream &out) {
+    if (not config.defaultGet<bool>("compiler_openmp", false)) {
+        return false;
+    }
+    if (block.rank != 0 or block._sweeps.empty() or block.isInnermost() or block.isSystemOnly()) {
+        return false;
+    }
+    // The threads of a tiled loop nest share the tiles instead (see `tileHeadWriter()`)
+    if (not jitk::get_tiled_loops(block).empty()) {
+        return false;
+    }
+    // The sweep outputs must be arrays since each thread updates its part of them
+    const set<bh_base*> temps = block.getAllTemps();
+    // NB: the threads share the rows of each step of the accumulates, thus the order of the steps is unchanged
+    for (const jitk::InstrPtr &instr: block._sweeps) {
+        if (util::exist(temps, instr->operand[0].base)) {
+            return false;
+        }
+    }
+    // All instructions must be in sub-loops without sweeps, which are the loops the threads share
+    for (const jitk::Block &b: block._block_list) {
+        if (b.isInstr() or not b.getLoop()._sweeps.empty() or (b.getLoop().size <= 1 and not symbols.shape_as_var)) {
+            return false;
+        }
+    }
+    // Let's only start the threads when the rows are large enough to pay for the barrier after each row
+    const jitk::LoopB &row = block._block_list[0].getLoop();
+    util::spaces(out, 4);
+    out << "#pragma omp parallel if(" << loopSize(symbols, row) << " >= 1024) num_threads(bh_num_threads)\n";
+    util::spaces(out, 4);
+    out << "{ // The threads share the rows of each iteration of the sweep\n";
+    _rows = true;
+    writeLoopBlock(symbols, nullptr, block, {}, false, out);
+    _rows = false;
+    util::spaces(out, 4);
+    out << "}\n";
+    return true;
+}
+
+bool EngineOpenMP::writeScanBlock(const jitk::SymbolTable &symbols, const jitk::LoopB &block, stringstream &out) {
+    if (not config.defaultGet<bool>("compiler_openmp", false)) {
+        return false;
+    }
+    if (block.rank != 0 or block._sweeps.empty() or not block.isInnermost() or block.isSystemOnly()) {
+        return false;
+    }
+    const vector<jitk::InstrPtr> ordered_block_sweeps = order_sweep_set(block._sweeps, symbols);
+
+    // The only instructions that access the accumulated arrays must be the accumulates themselves
+    // since the chunks are only correct after the second pass
+    set<const bh_base*> accumulated;
+    for (const jitk::InstrPtr &instr: ordered_block_sweeps) {
+        if (not openmp_scan_compatible(instr->opcode) or instr->operand[0].base->type == bh_type::BOOL) {
+            return false;
+        }
+        // The chunks reorder the additions and multiplications, which only integers are indifferent to
+        if (not parallel_scan and not bh_type_is_integer(instr->operand[0].base->type)) {
+            return false;
+        }
+        accumulated.insert(instr->operand[0].base);
+    }
+    for (const jitk::InstrPtr &instr: block.getAllInstr()) {
+        if (util::exist(block._sweeps, instr)) {
+            continue;
+        }
+        for (const bh_base *base: instr->get_bases_const()) {
+            if (util::exist(accumulated, base)) {
+                return false;
+            }
+        }
+    }
+    _scan_block_id = block._id;
+
+    // The accumulated arrays are arrays, thus a scope without temporaries or scalar replacements writes them
+    const jitk::Scope scope(symbols, nullptr, {}, vector<const bh_view*>(), vector<const bh_view*>());
+
+    util::spaces(out, 4);
+    out << "{ // Parallel scan, a chunk per thread\n";
+    // Use at most one thread per 1024 elements
+    util::spaces(out, 8);
+    out << "const uint64_t scan_size = " << loopSize(symbols, block) << ";\n";
+    util::spaces(out, 8);
+    out << "uint64_t scan_nthds = scan_size / 1024;\n";
+    util::spaces(out, 8);
+    out << "if (scan_nthds > (uint64_t) bh_num_threads) scan_nthds = bh_num_threads;\n";
+    util::spaces(out, 8);
+    out << "if (scan_nthds < 1) scan_nthds = 1;\n";
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        util::spaces(out, 8);
+        out << writeType(ordered_block_sweeps[i]->operand[0].base->type) << " scan_total" << i
+            << "[scan_nthds + 1];\n";
+    }
+    util::spaces(out, 8);
+    out << "#pragma omp parallel num_threads(scan_nthds)\n";
+    util::spaces(out, 8);
+    out << "{\n";
+    util::spaces(out, 12);
+    out << "const uint64_t scan_tid = omp_get_thread_num();\n";
+    util::spaces(out, 12);
+    out << "const uint64_t scan_ntid = omp_get_num_threads();\n";
+    util::spaces(out, 12);
+    out << "const uint64_t scan_begin = scan_size * scan_tid / scan_ntid;\n";
+    util::spaces(out, 12);
+    out << "const uint64_t scan_end = scan_size * (scan_tid + 1) / scan_ntid;\n";
+
+    // 1. pass: scan the chunk and save its total
+    writeLoopBlock(symbols, nullptr, block, {}, false, out);
+    util::spaces(out, 12);
+    out << "{\n";
+    util::spaces(out, 16);
+    out << "const uint64_t i0 = scan_end - 1;\n";
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        const bh_view &view = ordered_block_sweeps[i]->operand[0];
+        util::spaces(out, 16);
+        out << "scan_total" << i << "[scan_tid + 1] = ";
+        scope.getName(view, out);
+        write_array_subscription(scope, view, out);
+        out << ";\n";
+    }
+    util::spaces(out, 12);
+    out << "}\n";
+    util::spaces(out, 12);
+    out << "#pragma omp barrier\n";
+
+    // Then, the totals of the chunks are scanned such that `scan_total[t]` is the total of the first `t` chunks
+    util::spaces(out, 12);
+    out << "#pragma omp single\n";
+    util::spaces(out, 12);
+    out << "for (uint64_t t = 2; t <= scan_ntid; ++t) {\n";
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        const char *op = ordered_block_sweeps[i]->opcode == BH_ADD_ACCUMULATE ? " + " : " * ";
+        util::spaces(out, 16);
+        out << "scan_total" << i << "[t] = scan_total" << i << "[t - 1]" << op << "scan_total" << i << "[t];\n";
+    }
+    util::spaces(out, 12);
+    out << "}\n";
+
+    // 2. pass: combine each chunk with the total of the preceding chunks
+    util::spaces(out, 12);
+    out << "if (scan_tid > 0) {\n";
+    util::spaces(out, 16);
+    if (config.defaultGet<bool>("compiler_openmp_simd", false)) {
+        out << "#pragma omp simd\n";
+        util::spaces(out, 16);
+    }
+    out << "for (uint64_t i0 = scan_begin; i0 < scan_end; ++i0) {\n";
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        const bh_view &view = ordered_block_sweeps[i]->operand[0];
+        const char *op = ordered_block_sweeps[i]->opcode == BH_ADD_ACCUMULATE ? " + " : " * ";
+        stringstream name;
+        scope.getName(view, name);
+        write_array_subscription(scope, view, name);
+        util::spaces(out, 20);
+        out << name.str() << " = scan_total" << i << "[scan_tid]" << op << name.str() << ";\n";
+    }
+    util::spaces(out, 16);
+    out << "}\n";
+    util::spaces(out, 12);
+    out << "}\n";
+    util::spaces(out, 8);
+    out << "}\n";
+    util::spaces(out, 4);
+    out << "}\n";
+    _scan_block_id = -1;
+    return true;
+}
+
+bool EngineOpenMP::simdCompatible(const jitk::SymbolTable &symbols,
+                                  const jitk::Scope &scope,
+                                  const jitk::LoopB &block,
+                                  bool loop_is_peeled,
+                                  bh_type &dtype,
+                                  vector<string> &stride_checks) const {
+    if (not explicit_simd or not block.isInnermost() or block.isSystemOnly() or _scan_block_id == block._id) {
+        return false;
+    }
+    if (not symbols.shape_as_var and block.size < 2) {
+        return false;
+    }
+    // The reductions must go to scalars, which are combined with the vector accumulators after the loop
+    set<const bh_base*> reduced;
+    for (const jitk::InstrPtr &instr: block._sweeps) {
+        if (loop_is_peeled or not bh_opcode_is_reduction(instr->opcode) or scope.isArray(instr->operand[0])) {
+            return false;
+        }
+        reduced.insert(instr->operand[0].base);
+    }
+    // All operands must have the same float type and the arrays must be contiguous along the loop
+    const set<bh_base*> &local_tmps = block.getLocalTemps();
+    dtype = bh_type::BOOL;
+    for (const jitk::InstrPtr &instr: block.getLocalInstr()) {
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        if (not explicit_simd_compatible(instr->opcode)) {
+            return false;
+        }
+        // NB: the last operand of a reduction is the axis, which isn't an element
+        const bool is_sweep = util::exist(block._sweeps, instr);
+        for (size_t o = 0; o < (is_sweep ? 2 : instr->operand.size()); ++o) {
+            const bh_view &view = instr->operand[o];
+            const bh_type type = bh_is_constant(&view) ? instr->constant.type : view.base->type;
+            if (type != bh_type::FLOAT32 and type != bh_type::FLOAT64) {
+                return false;
+            }
+            if (dtype == bh_type::BOOL) {
+                dtype = type;
+            } else if (dtype != type) {
+                return false;
+            }
+            if (bh_is_constant(&view) or (is_sweep and o == 0)) {
+                continue;
+            }
+            if (util::exist(reduced, view.base) or scope.isScalarReplaced_RW(view.base)) {
+                return false;
+            }
+            if (scope.isTmp(view.base)) {
+                if (local_tmps.find(view.base) == local_tmps.end()) {
+                    return false;
+                }
+                continue;
+            }
+            // Arrays and scalar replaced inputs are loaded directly from the array
+            if (view.ndim != block.rank + 1 or bh_is_scalar(&view)) {
+                return false;
+            }
+            if (symbols.strides_as_var and symbols.existOffsetStridesID(view)) {
+                stringstream ss;
+                ss << "vs" << symbols.offsetStridesID(view) << "_" << block.rank << " == 1";
+                if (std::find(stride_checks.begin(), stride_checks.end(), ss.str()) == stride_checks.end()) {
+                    stride_checks.push_back(ss.str());
+                }
+            } else if (view.stride[block.rank] != 1) {
+                return false;
+            }
+        }
+    }
+    return dtype != bh_type::BOOL;
+}
+
+bool EngineOpenMP::writeSimdLoop(const jitk::SymbolTable &symbols,
+                                 jitk::Scope &scope,
+                                 const jitk::LoopB &block,
+                                 bool loop_is_peeled,
+                                 string &simd_begin,
+                                 stringstream &out) {
+    bh_type dtype;
+    vector<string> stride_checks;
+    if (not simdCompatible(symbols, scope, block, loop_is_peeled, dtype, stride_checks)) {
+        return false;
+    }
+    const string type = writeType(dtype);
+    const string vtype = "bh_simd_" + type;
+    const string len = "BH_SIMD_LEN_" + type;
+    const string itername = "i" + std::to_string(block.rank);
+    const string begin = loopBegin(block);
+    const string end = loopEnd(symbols, block);
+    const int indent = 4 + block.rank * 4;
+    const vector<jitk::InstrPtr> ordered_block_sweeps = order_sweep_set(block._sweeps, symbols);
+
+    simd_begin = itername + "_simd" + (_num_simd_loops > 0 ? std::to_string(_num_simd_loops) : "");
+    ++_num_simd_loops;
+    out << "uint64_t " << simd_begin << " = " << begin << ";\n";
+    util::spaces(out, indent);
+    if (stride_checks.empty()) {
+        out << "{ // Explicit SIMD loop\n";
+    } else {
+        out << "if (";
+        for (size_t i = 0; i < stride_checks.size(); ++i) {
+            out << (i > 0 ? " && " : "") << stride_checks[i];
+        }
+        out << ") { // Explicit SIMD loop, which requires contiguous arrays\n";
+    }
+    util::spaces(out, indent + 4);
+    out << "const uint64_t " << itername << "_simd_end = " << end << " - ";
+    if (begin == "0") {
+        out << end << " % " << len << ";\n";
+    } else {
+        out << "(" << end << " - " << begin << ") % " << len << ";\n";
+    }
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        util::spaces(out, indent + 4);
+        out << vtype << " vr" << i << " = bh_simd_set1_" << type << "(";
+        jitk::write_reduce_identity(ordered_block_sweeps[i]->opcode, dtype, out);
+        out << ");\n";
+    }
+
+    // The vectorized loop gets the same work-sharing as the regular loop (see `writeHeader()`)
+    if (config.defaultGet<bool>("compiler_openmp", false)) {
+        string clauses;
+        if (block.rank == 0 and not (_rows or _within_tiles or _within_pool or _within_chunks) and openmp_compatible(block, scope) and
+            parallelClauses(symbols, block, clauses)) {
+            util::spaces(out, indent + 4);
+            out << "#pragma omp parallel for" << clauses;
+            for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+                const bool add = ordered_block_sweeps[i]->opcode == BH_ADD_REDUCE;
+                out << " reduction(" << (add ? "bh_simd_add" : "bh_simd_mul") << ":vr" << i << ")";
+            }
+            out << "\n";
+        } else if (_rows and block.rank == 1) {
+            util::spaces(out, indent + 4);
+            out << "#pragma omp for\n";
+        }
+    }
+    util::spaces(out, indent + 4);
+    out << "for(uint64_t " << itername << " = " << begin << "; " << itername << " < " << itername << "_simd_end; "
+        << itername << " += " << len << ") {\n";
+
+    // Returns the vector of the input operand `o` of `instr`
+    auto operand = [&](const bh_instruction &instr, size_t o) -> string {
+        const bh_view &view = instr.operand[o];
+        stringstream ss;
+        if (bh_is_constant(&view)) {
+            ss << "bh_simd_set1_" << type << "(";
+            const int64_t const_id = symbols.constID(instr);
+            if (const_id >= 0) {
+                ss << "c" << const_id;
+            } else {
+                instr.constant.pprint(ss, false);
+            }
+            ss << ")";
+        } else if (scope.isTmp(view.base)) {
+            ss << "vt" << symbols.baseID(view.base);
+        } else {
+            ss << "bh_simd_load_" << type << "(&a" << symbols.baseID(view.base);
+            write_array_subscription(scope, view, ss, true);
+            ss << ")";
+        }
+        return ss.str();
+    };
+
+    set<const bh_base*> declared_tmps;
+    for (const jitk::Block &b: block._block_list) {
+        const jitk::InstrPtr instr = b.getInstr();
+        if (bh_opcode_is_system(instr->opcode)) {
+            continue;
+        }
+        util::spaces(out, indent + 8);
+        const auto sweep = std::find(ordered_block_sweeps.begin(), ordered_block_sweeps.end(), instr);
+        if (sweep != ordered_block_sweeps.end()) {
+            out << "vr" << (sweep - ordered_block_sweeps.begin())
+                << (instr->opcode == BH_ADD_REDUCE ? " += " : " *= ") << operand(*instr, 1) << ";\n";
+            continue;
+        }
+        vector<string> ops = {""};
+        for (size_t o = 1; o < instr->operand.size(); ++o) {
+            ops.push_back(operand(*instr, o));
+        }
+        stringstream expr;
+        jitk::write_simd_operation(*instr, ops, type, expr);
+        const bh_view &output = instr->operand[0];
+        if (scope.isTmp(output.base)) {
+            if (declared_tmps.insert(output.base).second) {
+                out << vtype << " ";
+            }
+            out << "vt" << symbols.baseID(output.base) << " = " << expr.str() << ";\n";
+        } else {
+            out << "bh_simd_store_" << type << "(&a" << symbols.baseID(output.base);
+            write_array_subscription(scope, output, out, true);
+            out << ", " << expr.str() << ");\n";
+        }
+    }
+    util::spaces(out, indent + 4);
+    out << "}\n";
+
+    // Finally, the vector accumulators are combined into the scalar reduction outputs
+    for (size_t i = 0; i < ordered_block_sweeps.size(); ++i) {
+        const bool add = ordered_block_sweeps[i]->opcode == BH_ADD_REDUCE;
+        const string name = scope.getName(ordered_block_sweeps[i]->operand[0]);
+        util::spaces(out, indent + 4);
+        out << name << " = " << name << (add ? " + bh_simd_hsum_" : " * bh_simd_hprod_") << type
+            << "(vr" << i << ");\n";
+    }
+    util::spaces(out, indent + 4);
+    out << simd_begin << " = " << itername << "_simd_end;\n";
+    util::spaces(out, indent);
+    out << "}\n";
+    util::spaces(out, indent);
+    return true;
+}
+
+bool EngineOpenMP::poolCompatible(const jitk::LoopB &block) const {
+    // The iterations of the outermost loop must be independent, which they are when the loop isn't sweeped.
+    // NB: tiled loops are shared by the OpenMP threads (see `tileHeadWriter()`)
+    return thread_pool != nullptr and block.rank == 0 and block._sweeps.empty() and not block.isSystemOnly() and
+           jitk::get_tiled_loops(block).empty();
+}
+
+vector<pair<string, string> > EngineOpenMP::poolArgs(const jitk::SymbolTable &symbols,
+                                                     const std::vector<bh_base*> &kernel_temps,
+                                                     size_t num_extents) {
+    vector<pair<string, string> > ret;
+    for (const bh_base *b: symbols.getParams()) {
+        ret.emplace_back(writeType(b->type) + "* __restrict__", "a" + std::to_string(symbols.baseID(b)));
+    }
+    for (const bh_base *b: kernel_temps) {
+        ret.emplace_back(writeType(b->type) + "* __restrict__", "a" + std::to_string(symbols.baseID(b)));
+    }
+    for (const bh_view *view: symbols.offsetStrideViews()) {
+        const string id = std::to_string(symbols.offsetStridesID(*view));
+        ret.emplace_back(writeType(bh_type::UINT64), "vo" + id);
+        for (int i = 0; i < view->ndim; ++i) {
+            ret.emplace_back(writeType(bh_type::UINT64), "vs" + id + "_" + std::to_string(i));
+        }
+    }
+    for (size_t i = 0; i < num_extents; ++i) {
+        ret.emplace_back(writeType(bh_type::UINT64), "e" + std::to_string(i));
+    }
+    for (const jitk::InstrPtr &instr: symbols.constIDs()) {
+        ret.emplace_back(writeType(instr->constant.type), "c" + std::to_string(symbols.constID(*instr)));
+    }
+    return ret;
+}
+
+void EngineOpenMP::writePoolBlocks(const std::vector<jitk::Block> &block_list,
+                                   const std::vector<bool> &pooled,
+                                   const jitk::SymbolTable &symbols,
+                                   const std::vector<bh_base*> &kernel_temps,
+                                   size_t num_extents,
+                                   std::stringstream &ss) {
+    // The callback and the pool are set by the launcher
+    ss << "static void *bh_pool;\n";
+    ss << "static bh_parallel_for_t bh_parallel_for;\n\n";
+
+    // The variables of `execute()` that the blocks use
+    const vector<pair<string, string> > args = poolArgs(symbols, kernel_temps, num_extents);
+    ss << "typedef struct {\n";
+    for (const pair<string, string> &arg: args) {
+        util::spaces(ss, 4);
+        ss << arg.first << " " << arg.second << ";\n";
+    }
+    ss << "} bh_pool_args;\n\n";
+
+    _within_pool = true;
+    for (size_t i = 0; i < block_list.size(); ++i) {
+        if (not pooled[i]) {
+            continue;
+        }
+        ss << "static void bh_pool_block" << i << "(void *bh_vargs, uint64_t i0_begin, uint64_t i0_end) {\n";
+        util::spaces(ss, 4);
+        ss << "const bh_pool_args *bh_args = bh_vargs;\n";
+        for (size_t j = 0; j < args.size(); ++j) {
+            util::spaces(ss, 4);
+            ss << args[j].first << " " << args[j].second << " = ";
+            // NB: the parameters are the first arguments (see `poolArgs()`)
+            if (symbols.assumeAligned() and j < symbols.getParams().size()) {
+                ss << "__builtin_assume_aligned(bh_args->" << args[j].second << ", " << BH_MEMORY_ALIGNMENT << ");\n";
+            } else {
+                ss << "bh_args->" << args[j].second << ";\n";
+            }
+        }
+        writeLoopBlock(symbols, nullptr, block_list[i].getLoop(), {}, false, ss);
+        ss << "}\n\n";
+    }
+    _within_pool = false;
+}
+
 void EngineOpenMP::writeKernel(const std::vector<jitk::Block> &block_list,
                                const jitk::SymbolTable &symbols,
                                const std::vector<bh_base*> &kernel_temps,
                                uint64_t codegen_hash,
                                std::stringstream &ss) {
+    _num_simd_loops = 0;
 
     // Write the need includes
     ss << "#include <stdint.h>\n";
     ss << "#include <stdlib.h>\n";
+    ss << "#include <string.h>\n";
     ss << "#include <stdbool.h>\n";
     ss << "#include <complex.h>\n";
     ss << "#include <tgmath.h>\n";
     ss << "#include <math.h>\n";
+    if (config.defaultGet<bool>("compiler_openmp", false)) {
+        ss << "#include <omp.h>\n";
+        openmp_declare_reductions(ss);
+        // The number of threads of the parallel regions, which the launcher sets
+        ss << "static int bh_num_threads;\n";
+    }
+    if (explicit_simd) {
+        if (config.defaultGet<bool>("simd_math_fast", false)) {
+            ss << "#define BH_SIMD_MATH_FAST\n";
+        }
+        ss << "#include <kernel_dependencies/simd_math_openmp.h>\n";
+    }
     if (symbols.useRandom()) { // Write the random function
         ss << "#include <kernel_dependencies/random123_openmp.h>\n";
     }
     writeUnionType(ss); // We always need to declare the union of all constant data types
     ss << "\n";
+    // The `parallel_for` callback of the thread pool, which the launcher receives (see `jitk::ThreadPool`)
+    ss << "typedef void (*bh_loop_body)(void *args, uint64_t begin, uint64_t end);\n";
+    ss << "typedef void (*bh_parallel_for_t)(void *pool, bh_loop_body body, void *args, uint64_t niters);\n";
+    ss << "\n";
+
+    // When the loop sizes are variables, the extents are the loop sizes followed by the sizes of the kernel temporaries
+    _loop_size_ids.clear();
+    size_t num_loops = 0, num_extents = 0;
+    if (symbols.shape_as_var) {
+        for (const jitk::LoopB *loop: jitk::get_all_loop_blocks(block_list)) {
+            _loop_size_ids.insert(make_pair(loop->_id, num_loops++));
+        }
+        num_extents = num_loops + kernel_temps.size();
+    }
+
+    // A strip-mined kernel executes all of its blocks on a chunk of rows at a time (see `jitk::strip_mine()`)
+    const jitk::StripMine &strip = symbols.strip;
+    const int64_t strip_rows = strip.rows;
+
+    // Write the blocks that the thread pool executes as functions
+    vector<bool> pooled(block_list.size(), false);
+    for (size_t i = 0; i < block_list.size(); ++i) {
+        pooled[i] = strip_rows == 0 and poolCompatible(block_list[i].getLoop());
+    }
+    const bool use_pool = std::find(pooled.begin(), pooled.end(), true) != pooled.end();
+    if (use_pool) {
+        writePoolBlocks(block_list, pooled, symbols, kernel_temps, num_extents, ss);
+    }
 
     // Write the header of the execute function
     ss << "void execute_" << codegen_hash;
-    writeKernelFunctionArguments(symbols, ss, nullptr);
+    writeKernelFunctionArguments(symbols, ss, nullptr, num_extents);
 
     // Write the block that makes up the body of 'execute()'
     ss << "{\n";
+    // Tell the compiler that the arrays are aligned, which `bh_memory_malloc()` guarantees (see `assume_aligned`)
+    if (symbols.assumeAligned()) {
+        for (const bh_base *b: symbols.getParams()) {
+            util::spaces(ss, 4);
+            ss << "a" << symbols.baseID(b) << " = __builtin_assume_aligned(a" << symbols.baseID(b) << ", "
+               << BH_MEMORY_ALIGNMENT << ");\n";
+        }
+    }
     // Write allocations of the kernel temporaries
-    for(const bh_base* b: kernel_temps) {
+    // NB: the kernel temporaries of a strip-mined kernel are scratch buffers of a window of rows per thread.
+    //     The chunks of a time-tiled kernel execute in order thus they share a single window.
+    const string strip_threads = config.defaultGet<bool>("compiler_openmp", false) and strip.steps == 1 ?
+                                 "bh_num_threads" : "1";
+    const bool strip_windows = not strip.windows.empty();
+    for(size_t i = 0; i < kernel_temps.size(); ++i) {
+        const bh_base* b = kernel_temps[i];
         util::spaces(ss, 4);
-        ss << writeType(b->type) << " * __restrict__ a" << symbols.baseID(b) << " = malloc(" << bh_base_size(b)
-           << ");\n";
+        if (strip_windows) {
+            ss << writeType(b->type) << " * __restrict__ a" << symbols.baseID(b) << "_scratch = malloc("
+               << strip_threads << " * " << strip.windows[i].rows * strip.windows[i].row_elems << " * sizeof("
+               << writeType(b->type) << "));\n";
+            continue;
+        }
+        ss << writeType(b->type) << " * __restrict__ a" << symbols.baseID(b) << " = malloc(";
+        if (symbols.shape_as_var) {
+            ss << "e" << num_loops + i << " * sizeof(" << writeType(b->type) << ")";
+        } else {
+            ss << bh_base_size(b);
+        }
+        ss << ");\n";
     }
     ss << "\n";
 
-    for(const jitk::Block &block: block_list) {
-        writeLoopBlock(symbols, nullptr, block.getLoop(), {}, false, ss);
+    if (strip_rows > 0) {
+        // The threads share the chunks unless they depend on the earlier chunks (see `jitk::time_tile()`),
+        // in which case the threads share the rows of each block instead
+        _within_chunks = strip.steps == 1;
+        if (_within_chunks and config.defaultGet<bool>("compiler_openmp", false)) {
+            util::spaces(ss, 4);
+            ss << "#pragma omp parallel for num_threads(bh_num_threads)\n";
+        }
+        util::spaces(ss, 4);
+        ss << "for (uint64_t i0_chunk = 0; i0_chunk < " << strip.size << "; i0_chunk += " << strip_rows << ") {\n";
+        util::spaces(ss, 8);
+        ss << "const uint64_t i0_chunk_end = i0_chunk + " << strip_rows << " < " << strip.size << " ? i0_chunk + "
+           << strip_rows << " : " << strip.size << ";\n";
+        if (strip_windows) {
+            util::spaces(ss, 8);
+            ss << "const int64_t bh_thread = "
+               << (config.defaultGet<bool>("compiler_openmp", false) ? "omp_get_thread_num()" : "0") << ";\n";
+        }
+        // The scratch buffers are rebased such that the window of the chunk lands in the buffer of the thread
+        for(size_t i = 0; i < kernel_temps.size() and strip_windows; ++i) {
+            const bh_base* b = kernel_temps[i];
+            const jitk::StripMine::Window &window = strip.windows[i];
+            util::spaces(ss, 8);
+            ss << writeType(b->type) << " * __restrict__ a" << symbols.baseID(b) << " = a" << symbols.baseID(b)
+               << "_scratch + (bh_thread * " << window.rows << " - ((int64_t) i0_chunk + " << window.offset << ")) * "
+               << window.row_elems << ";\n";
+        }
+        // Returns the row `offset` rows from `row` clipped to the outermost loop of `block`
+        const auto clip = [&](const string &row, int64_t offset, const jitk::LoopB &block) {
+            const string size = "(int64_t) " + loopSize(symbols, block);
+            const string ret = "(int64_t) " + row + (offset < 0 ? " - " : " + ") + std::to_string(std::abs(offset));
+            return "(" + ret + " < 0 ? 0 : " + ret + " > " + size + " ? " + size + " : " + ret + ")";
+        };
+        for (size_t i = 0; i < strip.extents.size(); ++i) {
+            if (block_list[i % block_list.size()].isSystemOnly()) {
+                continue;
+            }
+            const jitk::LoopB &block = block_list[i % block_list.size()].getLoop();
+            const pair<int64_t, int64_t> &extent = strip.extents[i];
+            if (extent.first == 0 and extent.second == 0 and block.size == strip.size) {
+                _strip_begin = "i0_chunk";
+                _strip_end = "i0_chunk_end";
+            } else {
+                // The block executes the rows around the chunk that the later blocks read, the skewed rows of its
+                // step, or is smaller than the chunks
+                _strip_begin = "i0_begin" + std::to_string(i);
+                _strip_end = "i0_end" + std::to_string(i);
+                util::spaces(ss, 8);
+                ss << "const uint64_t " << _strip_begin << " = " << clip("i0_chunk", extent.first, block) << ";\n";
+                util::spaces(ss, 8);
+                ss << "const uint64_t " << _strip_end << " = " << clip("i0_chunk_end", extent.second, block) << ";\n";
+            }
+            writeLoopBlock(symbols, nullptr, block, {}, false, ss);
+        }
+        // The next chunk of a time-tiled kernel reads the rows that the window ends with (see `jitk::time_tile()`)
+        for(size_t i = 0; i < kernel_temps.size() and strip_windows and strip.steps > 1; ++i) {
+            const bh_base* b = kernel_temps[i];
+            const jitk::StripMine::Window &window = strip.windows[i];
+            if (window.rows > strip_rows) {
+                util::spaces(ss, 8);
+                ss << "memmove(a" << symbols.baseID(b) << "_scratch, a" << symbols.baseID(b) << "_scratch + "
+                   << strip_rows * window.row_elems << ", " << (window.rows - strip_rows) * window.row_elems
+                   << " * sizeof(" << writeType(b->type) << "));\n";
+            }
+        }
+        _strip_begin.clear();
+        _strip_end.clear();
+        _within_chunks = false;
+        util::spaces(ss, 4);
+        ss << "}\n";
+    }
+
+    if (use_pool) {
+        util::spaces(ss, 4);
+        ss << "bh_pool_args bh_args = {";
+        const vector<pair<string, string> > args = poolArgs(symbols, kernel_temps, num_extents);
+        for (size_t i = 0; i < args.size(); ++i) {
+            ss << (i == 0 ? "" : ", ") << args[i].second;
+        }
+        ss << "};\n";
+    }
+    for(size_t i = 0; i < block_list.size() and strip_rows == 0; ++i) {
+        const jitk::LoopB &block = block_list[i].getLoop();
+        if (pooled[i]) {
+            util::spaces(ss, 4);
+            ss << "bh_parallel_for(bh_pool, bh_pool_block" << i << ", &bh_args, " << loopSize(symbols, block) << ");\n";
+        } else if (not (writeRowsBlock(symbols, block, ss) or writeScanBlock(symbols, block, ss))) {
+            writeLoopBlock(symbols, nullptr, block, {}, false, ss);
+        }
     }
 
     // Write frees of the kernel temporaries
     ss << "\n";
     for(const bh_base* b: kernel_temps) {
         util::spaces(ss, 4);
-        ss << "free(" << "a" << symbols.baseID(b) << ");\n";
+        ss << "free(" << "a" << symbols.baseID(b) << (strip_windows ? "_scratch" : "") << ");\n";
     }
     ss << "}\n\n";
 
@@ -354,7 +1536,18 @@ void EngineOpenMP::writeKernel(const std::vector<jitk::Block> &block_list,
     // to typed arrays and call the execute function
     {
         ss << "void launcher_" << codegen_hash
-           << "(void* data_list[], uint64_t offset_strides[], union dtype constants[]) {\n";
+           << "(void* data_list[], uint64_t offset_strides[], union dtype constants[], "
+              "void *pool, bh_parallel_for_t parallel_for, int num_threads) {\n";
+        if (config.defaultGet<bool>("compiler_openmp", false)) {
+            util::spaces(ss, 4);
+            ss << "bh_num_threads = num_threads < omp_get_max_threads() ? num_threads : omp_get_max_threads();\n";
+        }
+        if (use_pool) {
+            util::spaces(ss, 4);
+            ss << "bh_pool = pool;\n";
+            util::spaces(ss, 4);
+            ss << "bh_parallel_for = parallel_for;\n";
+        }
         for(size_t i = 0; i < symbols.getParams().size(); ++i) {
             util::spaces(ss, 4);
             bh_base *b = symbols.getParams()[i];
@@ -379,6 +1572,9 @@ void EngineOpenMP::writeKernel(const std::vector<jitk::Block> &block_list,
                 stmp << "offset_strides[" << count++ << "], ";
             }
         }
+        for (size_t i = 0; i < num_extents; ++i) {
+            stmp << "offset_strides[" << count++ << "], ";
+        }
 
         if (not symbols.constIDs().empty()) {
             uint64_t i = 0;
@@ -404,6 +1600,12 @@ std::string EngineOpenMP::info() const {
     ss << "OpenMP:"                                                        << "\n";
     ss << "  Hardware threads: " << std::thread::hardware_concurrency()    << "\n";
     ss << "  JIT Command: \"" << compiler.cmd_template << "\"\n";
+    if (thread_pool != nullptr) {
+        ss << "  Thread pool: " << thread_pool->size() << " threads\n";
+    }
+    if (not fallback_compiler.cmd_template.empty()) {
+        ss << "  JIT Fallback Command: \"" << fallback_compiler.cmd_template << "\"\n";
+    }
     return ss.str();
 }
 
@@ -29,37 +29,221 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <jitk/statistics.hpp>
 #include <jitk/block.hpp>
 #include <jitk/compiler.hpp>
+#include <jitk/compile_pool.hpp>
 #include <jitk/fuser_cache.hpp>
 #include <jitk/codegen_util.hpp>
 #include <jitk/codegen_cache.hpp>
+#include <jitk/plan_cache.hpp>
+#include <jitk/thread_pool.hpp>
 
 #include <jitk/engines/engine_cpu.hpp>
 
 namespace bohrium {
 
-typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[]);
+typedef jitk::KernelFunction KernelFunction;
 
 class EngineOpenMP : public jitk::EngineCPU {
 private:
     std::map<uint64_t, KernelFunction> _functions;
     std::vector<void*> _lib_handles;
 
+    // Kernels compiled with the fallback compiler, which we use while the regular compile runs in the background
+    std::map<uint64_t, KernelFunction> _fallback_functions;
+
     // The compiler to use when function doesn't exist
     const jitk::Compiler compiler;
 
+    // The (cheaper) compiler to use while waiting on the background compile of a kernel
+    const jitk::Compiler fallback_compiler;
+    uint64_t fallback_compilation_hash;
+
+    // Tiered JIT: the specialized kernels, their compiler, and the thresholds that makes a kernel hot
+    std::map<uint64_t, KernelFunction> _tier1_functions;
+    const jitk::Compiler tier1_compiler;
+    uint64_t tier1_compilation_hash;
+    const uint64_t tier_up_calls;
+    const double tier_up_time;
+
+    // The execution plans of previously executed BhIRs, which we replay rather than fuse, codegen, and lookup kernels
+    const bool use_plan_cache;
+    // Whether the kernels may assume that the arrays are aligned, which the plans must check (see `assume_aligned`)
+    const bool assume_aligned;
+    jitk::PlanCache plan_cache;
+
+    // The plan being recorded by `handleExecution()` (nullptr when not recording), the index of the base arrays
+    // in the plan, and whether the plan is final, i.e. whether a new execution would launch the same kernels
+    jitk::ExecutionPlan *_plan = nullptr;
+    std::map<const bh_base*, size_t> _plan_base_ids;
+    bool _plan_final = false;
+
+    // Map of a loop block (its `_id`) in the kernel being written to the ID of its size variable (see `shape_as_var`)
+    // NB: we use `_id` since it is preserved when a loop block is copied, e.g. when peeled
+    std::map<int, size_t> _loop_size_ids;
+
+    // Parallelize the float accumulates as well as the integer accumulates (see `writeScanBlock()`)
+    const bool parallel_scan;
+
+    // The `_id` of the accumulating loop block of the scan being written by `writeScanBlock()` (-1 when not writing)
+    int _scan_block_id = -1;
+    // Whether `writeRowsBlock()` is writing a block, which makes the threads share the sub-loops (the rows)
+    bool _rows = false;
+
+    // Write the innermost loops over contiguous float arrays using explicit vector types (see `writeSimdLoop()`)
+    const bool explicit_simd;
+
+    // The minimum work (number of iterations of a loop nest) of a parallel loop
+    const uint64_t parallel_threshold;
+
+    // Choose the number of threads of each launch such that each thread gets at least `adaptive_thread_time` sec.
+    // of the work of the launch, which we estimate from the time per iteration of the previous launches.
+    // The overhead of a parallel launch (`machine_parallel_overhead`) doesn't count as work.
+    const bool adaptive_threads;
+    const double adaptive_thread_time;
+    const double parallel_overhead;
+    unsigned int max_threads;
+
+    // The persistent threads that execute the parallel loops instead of OpenMP (nullptr when disabled)
+    std::unique_ptr<jitk::ThreadPool> thread_pool;
+    // Whether `writePoolBlocks()` is writing a block, which the threads of `thread_pool` share
+    bool _within_pool = false;
+    // The bounds of the outermost loop of the block of a strip-mined kernel that `writeKernel()` is writing, which
+    // executes a chunk at a time (empty when not writing a strip-mined kernel)
+    std::string _strip_begin, _strip_end;
+    // Whether the threads share the chunks of the strip-mined kernel that `writeKernel()` is writing
+    bool _within_chunks = false;
+
+    // Directory of the lock files that makes sure each kernel is compiled once by the processes
+    // sharing the cache dir (empty means disabled)
+    boost::filesystem::path cache_lock_dir;
+
+    // The worker threads that compile kernels in the background
+    jitk::CompilePool compile_pool;
+
+    // Compile `source` into the tmp dir (and publish it in the cache dir when `cache_lock_dir` is enabled).
+    // NB: called by the background compile workers thus it must be thread-safe
+    void compileKernel(const jitk::Compiler &compiler, uint64_t compilation_hash,
+                       uint64_t hash, const std::string &source) const;
+
+    // Return the binary file of the kernel `hash` compiled by `compileKernel()`
+    boost::filesystem::path compiledBinfile(uint64_t compilation_hash, uint64_t hash) const;
+
+    // Call the kernel function `func` with the given arguments and return the execution time, where `work` is the
+    // number of iterations of the launch. The number of threads is chosen from and registered in `kernel_stat`,
+    // which are the statistics of the kernel.
+    std::chrono::duration<double> launch(KernelFunction func,
+                                         std::vector<void*> &data_list,
+                                         std::vector<uint64_t> &offset_and_strides,
+                                         std::vector<bh_constant_value> &constant_arg,
+                                         uint64_t work,
+                                         jitk::KernelStats &kernel_stat);
+
+    // Add the launch of `func` to the plan being recorded (if any)
+    void recordKernel(KernelFunction func,
+                      const std::vector<bh_base*> &non_temps,
+                      const std::vector<uint64_t> &offset_and_strides,
+                      const std::vector<const bh_instruction*> &constants,
+                      uint64_t work,
+                      const std::string &kernel_name,
+                      bool tier1,
+                      bool may_tier_up);
+
+    // Execute `bhir` by replaying `plan` where `bases` are the base arrays found by `jitk::PlanCache::key()`.
+    // Returns false when the plan is outdated.
+    bool executePlan(jitk::ExecutionPlan &plan, const BhIR &bhir, const std::vector<bh_base*> &bases);
+
+    // Tiered JIT: returns true when the tiered JIT is enabled and `kernel` has reached a tier-up threshold
+    bool reachedTierUp(const jitk::KernelStats &kernel) const;
+
     // Return a kernel function based on the given 'source' and the name of the kernel function
     KernelFunction getFunction(const std::string &source, const std::string &func_name);
 
+    // Return the fallback kernel function of 'source', which we compile if it doesn't exist
+    KernelFunction getFallbackFunction(const std::string &source, const std::string &func_name);
+
+    // Load the kernel function 'func_name' from the shared library 'binfile'
+    KernelFunction loadFunction(const boost::filesystem::path &binfile, const std::string &func_name);
+
+    // Returns the size of the for-loop of `block`, which is a variable when the loop sizes are variables
+    std::string loopSize(const jitk::SymbolTable &symbols, const jitk::LoopB &block) const;
+
+    // Returns false when the work of `block` is below `parallel_threshold` and otherwise sets `clauses` to the
+    // clauses of the OpenMP parallel pragma of `block`, which limit the threads and check the work at runtime
+    bool parallelClauses(const jitk::SymbolTable &symbols, const jitk::LoopB &block, std::string &clauses) const;
+
+    // Returns the end of the for-loop of `block`, which is the end of the current tile when `block` is tiled
+    std::string loopEnd(const jitk::SymbolTable &symbols, const jitk::LoopB &block) const;
+
+    // Returns true when the thread pool can execute `block`, which is a block of the kernel
+    bool poolCompatible(const jitk::LoopB &block) const;
+
+    // Returns the types and names of the variables of the execute function that the pool blocks use
+    std::vector<std::pair<std::string, std::string> > poolArgs(const jitk::SymbolTable &symbols,
+                                                               const std::vector<bh_base*> &kernel_temps,
+                                                               size_t num_extents);
+
+    // Writes the blocks of `block_list` that are `pooled` as functions of the iterations [i0_begin, i0_end) of
+    // their outermost loop, which the execute function passes to the `parallel_for` callback of the thread pool
+    void writePoolBlocks(const std::vector<jitk::Block> &block_list,
+                         const std::vector<bool> &pooled,
+                         const jitk::SymbolTable &symbols,
+                         const std::vector<bh_base*> &kernel_temps,
+                         size_t num_extents,
+                         std::stringstream &ss);
+
+    // Returns true when `writeSimdLoop()` can vectorize `block` in which case `dtype` is set to the element type
+    // and `stride_checks` to the conditions that the strides must fulfill at runtime
+    bool simdCompatible(const jitk::SymbolTable &symbols,
+                        const jitk::Scope &scope,
+                        const jitk::LoopB &block,
+                        bool loop_is_peeled,
+                        bh_type &dtype,
+                        std::vector<std::string> &stride_checks) const;
+
+    // Writes the innermost `block` as a loop over the vector types of `kernel_dependencies/simd_openmp.h`,
+    // which covers the iterations up to a multiple of the vector length. The regular loop of `block` must follow
+    // and start at `simd_begin`. Returns false when `block` isn't compatible.
+    bool writeSimdLoop(const jitk::SymbolTable &symbols,
+                       jitk::Scope &scope,
+                       const jitk::LoopB &block,
+                       bool loop_is_peeled,
+                       std::string &simd_begin,
+                       std::stringstream &out);
+    // The number of explicit SIMD loops that `writeKernel()` has written, which numbers their variables since
+    // sibling loops share a scope
+    uint64_t _num_simd_loops = 0;
+
 public:
     EngineOpenMP(const ConfigParser &config, jitk::Statistics &stat);
 
     ~EngineOpenMP();
 
+    // Execute `bhir` using the plan cache when enabled
+    void handleExecution(BhIR *bhir) override;
+
     void execute(const std::string &source,
                  uint64_t codegen_hash,
                  const std::vector<bh_base*> &non_temps,
                  const std::vector<const bh_view*> &offset_strides,
-                 const std::vector<const bh_instruction*> &constants) override;
+                 const std::vector<uint64_t> &extents,
+                 const std::vector<const bh_instruction*> &constants,
+                 uint64_t work) override;
+
+    // Compile the kernel `source` in the background if it isn't available already
+    void prefetch(const std::string &source, uint64_t codegen_hash) override;
+
+    // Tiered JIT: a kernel is hot when it has been called `tier_up_calls` times or executed for `tier_up_time` sec.
+    bool isHot(const std::string &source) override;
+
+    bool executeSpecialized(const std::string &source,
+                            uint64_t codegen_hash,
+                            const std::vector<bh_base*> &non_temps,
+                            const std::string &generic_source,
+                            uint64_t work) override;
+
+    // The chunks of a streamed kernel read and write the spilled arrays thus the plan must not replay them
+    void beginStreaming() override {
+        _plan_final = false;
+    }
 
     void setConstructorFlag(std::vector<bh_instruction*> &instr_list) override;
 
@@ -75,6 +259,18 @@ public:
                      const jitk::LoopB &block,
                      std::stringstream &out);
 
+    // Writes `block`, which sweeps the outermost axis, as a parallel region where the threads share the sub-loops
+    // (the rows) of each iteration of the sweep. This parallelizes accumulates and reductions to arrays without
+    // atomics. Returns false when `block` isn't compatible.
+    bool writeRowsBlock(const jitk::SymbolTable &symbols, const jitk::LoopB &block, std::stringstream &out);
+
+    // Writes `block`, which is an one-dimensional accumulate, as a parallel prefix scan and returns false when
+    // `block` isn't compatible. The scan is split into a chunk per thread, which is scanned in parallel,
+    // followed by adding the total of the preceding chunks to each chunk.
+    bool writeScanBlock(const jitk::SymbolTable &symbols, const jitk::LoopB &block, std::stringstream &out);
+
+    std::string loopBegin(const jitk::LoopB &block) override;
+
     void loopHeadWriter(const jitk::SymbolTable &symbols,
                         jitk::Scope &scope,
                         const jitk::LoopB &block,
@@ -82,6 +278,11 @@ public:
                         const std::vector<uint64_t> &thread_stack,
                         std::stringstream &out) override;
 
+    // Writes the heads of the loops over the tiles, which the threads share
+    void tileHeadWriter(const jitk::SymbolTable &symbols,
+                        const std::vector<const jitk::LoopB*> &tiled,
+                        std::stringstream &out) override;
+
     // Return a YAML string describing this component
     std::string info() const override;
 
@@ -134,7 +134,16 @@ Impl::~Impl() {
 
 void Impl::execute(BhIR *bhir) {
     bh_base *cond = bhir->getRepeatCondition();
-    for (uint64_t i = 0; i < bhir->getNRepeats(); ++i) {
+
+    // The repeats go to time-tiled kernels when possible, which execute several repeats per chunk of rows
+    // NB: the extension methods execute outside of the kernels thus they cannot be time-tiled
+    bool has_extmethod = false;
+    for (const bh_instruction &instr: bhir->instr_list) {
+        has_extmethod = has_extmethod or util::exist(extmethods, instr.opcode);
+    }
+    uint64_t i = has_extmethod ? 0 : engine.handleTimeTiling(bhir);
+
+    for (; i < bhir->getNRepeats(); ++i) {
         // Let's handle extension methods
         engine.handleExtmethod(*this, bhir);
 
@@ -21,6 +21,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <bh_opcode.h>
 #include <jitk/base_db.hpp>
+#include <jitk/instruction.hpp>
 
 // Return the OpenMP reduction symbol
 const char* openmp_reduce_symbol(bh_opcode opcode) {
@@ -39,27 +40,72 @@ const char* openmp_reduce_symbol(bh_opcode opcode) {
             return "max";
         case BH_MINIMUM_REDUCE:
             return "min";
+        case BH_LOGICAL_AND_REDUCE:
+            return "&&";
+        case BH_LOGICAL_OR_REDUCE:
+            return "||";
+        case BH_LOGICAL_XOR_REDUCE:
+            return "bh_logical_xor"; // Declared by `openmp_declare_reductions()`
         default:
             return NULL;
     }
 }
 
+// Write the declarations of the user-defined reductions of `openmp_reduce_symbol()`
+void openmp_declare_reductions(std::stringstream &out) {
+    out << "#pragma omp declare reduction(bh_logical_xor: bool: omp_out = !omp_out != !omp_in) "
+           "initializer(omp_priv = false)\n";
+}
+
 // Is 'opcode' compatible with OpenMP reductions such as reduction(+:var)
 bool openmp_reduce_compatible(bh_opcode opcode) {
     return openmp_reduce_symbol(opcode) != NULL;
 }
 
-// Is the 'block' compatible with OpenMP
-bool openmp_compatible(const bohrium::jitk::LoopB &block) {
-    // For now, all sweeps must be reductions
+// Does 'instr' support the OpenMP Atomic guard?
+bool openmp_atomic_compatible(const bh_instruction &instr) {
+    if (bh_type_is_complex(instr.operand[0].base->type)) {
+        return false;
+    }
+    switch (instr.opcode) {
+        case BH_ADD_REDUCE:
+        case BH_MULTIPLY_REDUCE:
+        case BH_BITWISE_AND_REDUCE:
+        case BH_BITWISE_OR_REDUCE:
+        case BH_BITWISE_XOR_REDUCE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Is the 'block' compatible with OpenMP "parallel for"? All sweeps must be reductions that either reduce into a
+// scalar using an OpenMP reduction clause or support the OpenMP Atomic guard.
+// NB: we never use the OpenMP Critical guard since a lock per element is slower than a sequential loop
+bool openmp_compatible(const bohrium::jitk::LoopB &block, const bohrium::jitk::Scope &scope) {
     for (const bohrium::jitk::InstrPtr instr: block._sweeps) {
         if (not bh_opcode_is_reduction(instr->opcode)) {
             return false;
         }
+        const bh_view &view = instr->operand[0];
+        if (not (openmp_reduce_compatible(instr->opcode) and (scope.isScalarReplaced(view) or scope.isTmp(view.base)))
+            and not openmp_atomic_compatible(*instr)) {
+            return false;
+        }
     }
     return true;
 }
 
+// Is 'opcode' an accumulate that the parallel prefix scan supports
+bool openmp_scan_compatible(bh_opcode opcode) {
+    return opcode == BH_ADD_ACCUMULATE or opcode == BH_MULTIPLY_ACCUMULATE;
+}
+
+// Is 'opcode' supported by the explicit SIMD loops, which vectorize the reductions into scalars themselves
+bool explicit_simd_compatible(bh_opcode opcode) {
+    return opcode == BH_ADD_REDUCE or opcode == BH_MULTIPLY_REDUCE or bohrium::jitk::has_simd_operation(opcode);
+}
+
 // Is the 'block' compatible with OpenMP SIMD
 bool simd_compatible(const bohrium::jitk::LoopB &block,
                      const bohrium::jitk::Scope &scope) {
@@ -79,17 +125,3 @@ bool simd_compatible(const bohrium::jitk::LoopB &block,
     }
     return true;
 }
-
-// Does 'opcode' support the OpenMP Atomic guard?
-bool openmp_atomic_compatible(bh_opcode opcode) {
-    switch (opcode) {
-        case BH_ADD_REDUCE:
-        case BH_MULTIPLY_REDUCE:
-        case BH_BITWISE_AND_REDUCE:
-        case BH_BITWISE_OR_REDUCE:
-        case BH_BITWISE_XOR_REDUCE:
-            return true;
-        default:
-            return false;
-    }
-}